@@ -32,13 +32,25 @@ john_register_one(&fmt_sevenzip);
 #include "sha2.h"
 #include "crc32.h"
 #include "unicode.h"
+#include "sse-intrinsics.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL		"7z"
 #define FORMAT_NAME		"7-Zip"
 #define FORMAT_TAG		"$7z$"
 #define TAG_LENGTH		4
+/* OpenSSL's SHA-NI code is faster than our SIMD lanes, so only use them without it */
+#if defined(MMX_COEF_SHA256) && !defined(__SHA__)
+#define SEVENZIP_SIMD
+#endif
+
+#ifdef SEVENZIP_SIMD
+#define NBKEYS			MMX_COEF_SHA256
+#define ALGORITHM_NAME		"SHA256 " SHA256_ALGORITHM_NAME " AES"
+#else
+#define NBKEYS			1
 #define ALGORITHM_NAME		"SHA256 AES 32/" ARCH_BITS_STR
+#endif
 #define BENCHMARK_COMMENT	" (512K iterations)"
 #define BENCHMARK_LENGTH	-1
 #define BINARY_SIZE		0
@@ -46,11 +58,12 @@ john_register_one(&fmt_sevenzip);
 #define PLAINTEXT_LENGTH	125
 #define SALT_SIZE		sizeof(struct custom_salt)
 #define SALT_ALIGN		4
-#define MIN_KEYS_PER_CRYPT	1
-#define MAX_KEYS_PER_CRYPT	1
+#define MIN_KEYS_PER_CRYPT	NBKEYS
+#define MAX_KEYS_PER_CRYPT	NBKEYS
 #define OMP_SCALE               1 // tuned on core i7
 
 #define BIG_ENOUGH 		(8192 * 32)
+#define MIN(a, b)		(((a) > (b)) ? (b) : (a))
 
 static struct fmt_tests sevenzip_tests[] = {
 	/* CRC checks passes for these hashes */
@@ -65,6 +78,13 @@ static struct fmt_tests sevenzip_tests[] = {
 
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static int *cracked;
+static int *survivors;
+#ifdef SEVENZIP_SIMD
+static UTF16 (*saved_utf16)[PLAINTEXT_LENGTH + 1];
+static int *saved_len;
+static int *key_order;
+static unsigned char (*derived_key)[32];
+#endif
 
 static struct custom_salt {
 	int NumCyclesPower;
@@ -94,6 +114,18 @@ static void init(struct fmt_main *self)
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	cracked = mem_calloc_tiny(sizeof(*cracked) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	survivors = mem_calloc_tiny(sizeof(*survivors) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#ifdef SEVENZIP_SIMD
+	saved_utf16 = mem_calloc_tiny(sizeof(*saved_utf16) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	saved_len = mem_calloc_tiny(sizeof(*saved_len) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	key_order = mem_calloc_tiny(sizeof(*key_order) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	derived_key = mem_calloc_tiny(sizeof(*derived_key) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#endif
 	CRC32_Init(&crc);
 }
 
@@ -221,6 +253,34 @@ static int validFolder(unsigned char *data)
 	return 0;
 }
 
+/*
+ * Cheap first stage: decrypt only the last AES block and look at the zero
+ * padding past unpacksize. Returns 0 if the key can be rejected, 1 if the
+ * full decrypt and CRC check in sevenzip_decrypt() is needed.
+ */
+static int sevenzip_padding_check(unsigned char *derived_key)
+{
+	AES_KEY akey;
+	unsigned char out[16];
+	unsigned char *prev;
+	int i, nbytes;
+
+	nbytes = cur_salt->length - cur_salt->unpacksize;
+	if (nbytes <= 0 || cur_salt->length < 16 || cur_salt->length & 15)
+		return 1;
+	if (nbytes > 16)
+		nbytes = 16;
+
+	prev = cur_salt->length > 16 ?
+		&cur_salt->data[cur_salt->length - 32] : cur_salt->iv;
+	AES_set_decrypt_key(derived_key, 256, &akey);
+	AES_decrypt(&cur_salt->data[cur_salt->length - 16], out, &akey);
+	for (i = 16 - nbytes; i < 16; i++)
+		if (out[i] != prev[i])
+			return 0;
+	return 1;
+}
+
 static int sevenzip_decrypt(unsigned char *derived_key, unsigned char *data)
 {
 #ifdef _MSC_VER
@@ -306,6 +366,19 @@ static int sevenzip_decrypt(unsigned char *derived_key, unsigned char *data)
 
 
 
+/* Convert password to utf-16-le format (--encoding aware) */
+static int sevenzip_utf16(UTF8 *password, UTF16 *buffer)
+{
+	int len;
+
+	len = enc_to_utf16(buffer, PLAINTEXT_LENGTH, password, strlen((char*)password));
+	if (len <= 0) {
+		password[-len] = 0; // match truncation
+		len = strlen16(buffer);
+	}
+	return len * 2;
+}
+
 void sevenzip_kdf(UTF8 *password, unsigned char *master)
 {
 	int len;
@@ -318,13 +391,7 @@ void sevenzip_kdf(UTF8 *password, unsigned char *master)
 #endif
 	SHA256_CTX sha;
 
-	/* Convert password to utf-16-le format (--encoding aware) */
-	len = enc_to_utf16(buffer, PLAINTEXT_LENGTH, password, strlen((char*)password));
-	if (len <= 0) {
-		password[-len] = 0; // match truncation
-		len = strlen16(buffer);
-	}
-	len *= 2;
+	len = sevenzip_utf16(password, buffer);
 
 	/* kdf */
         SHA256_Init(&sha);
@@ -343,10 +410,171 @@ void sevenzip_kdf(UTF8 *password, unsigned char *master)
 	SHA256_Final(master, &sha);
 }
 
+#ifdef SEVENZIP_SIMD
+/*
+ * Lane-parallel version of sevenzip_kdf(). 32 rounds of password||counter
+ * always fill a whole number of SHA-256 blocks (the UTF-16 length is even),
+ * so each lane gets a buffer with 32 copies of its password and only the
+ * counters are patched between periods. The lanes then step through their
+ * own buffer one block per SSESHA256body call, and the padding block of
+ * all lanes is done in one last call. Keys are sorted by length first, so
+ * lanes in a batch normally finish together.
+ */
+#define PERIOD_ROUNDS	32
+#define STATE_POS(j, w)	((w) * MMX_COEF_SHA256 + (j))
+
+static void sort_by_length(int count)
+{
+	unsigned int first[2 * PLAINTEXT_LENGTH + 2];
+	int index;
+
+	memset(first, 0, sizeof(first));
+	for (index = 0; index < count; index++)
+		first[saved_len[index] + 1]++;
+	for (index = 1; index <= 2 * PLAINTEXT_LENGTH + 1; index++)
+		first[index] += first[index - 1];
+	for (index = 0; index < count; index++)
+		key_order[first[saved_len[index]]++] = index;
+}
+
+static void sevenzip_kdf_sse(const int *order, int n)
+{
+	static const ARCH_WORD_32 sha256_iv[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	JTR_ALIGN(16) ARCH_WORD_32 block[16 * NBKEYS];
+	JTR_ALIGN(16) ARCH_WORD_32 state[8 * NBKEYS];
+	ARCH_WORD_32 final_state[8 * NBKEYS];
+	struct {
+		ARCH_WORD_32 *stream;
+		unsigned int RawLength, blk;
+		long long period;
+	} lane[NBKEYS];
+	long long periods = ((long long)1 << cur_salt->NumCyclesPower) / PERIOD_ROUNDS;
+	ARCH_WORD_32 *streams;
+	unsigned int i;
+	int j, active = n;
+
+	if (!periods) {
+		for (j = 0; j < n; j++)
+			sevenzip_kdf((UTF8*)saved_key[order[j]], derived_key[order[j]]);
+		return;
+	}
+
+	streams = mem_alloc(n * PERIOD_ROUNDS * (2 * PLAINTEXT_LENGTH + 8));
+	for (j = 0; j < n; j++) {
+		int index = order[j];
+		unsigned char *p;
+
+		lane[j].RawLength = saved_len[index] + 8;
+		lane[j].stream = j ? lane[j - 1].stream +
+			PERIOD_ROUNDS / 4 * lane[j - 1].RawLength : streams;
+		lane[j].period = lane[j].blk = 0;
+		p = (unsigned char*)lane[j].stream;
+		for (i = 0; i < PERIOD_ROUNDS; i++) {
+			memcpy(p, saved_utf16[index], saved_len[index]);
+			p += lane[j].RawLength;
+		}
+	}
+	for (j = 0; j < NBKEYS; j++)
+		for (i = 0; i < 8; i++)
+			state[STATE_POS(j, i)] = sha256_iv[i];
+	memcpy(final_state, state, sizeof(final_state));
+
+	while (active) {
+		for (j = 0; j < n; j++) {
+			unsigned int L = lane[j].RawLength;
+			ARCH_WORD_32 *data;
+
+			if (lane[j].period == periods)
+				continue;
+			if (lane[j].blk == 0) {
+				unsigned char *p = (unsigned char*)lane[j].stream + L - 8;
+				long long round = lane[j].period * PERIOD_ROUNDS;
+				unsigned int k;
+
+				for (i = 0; i < PERIOD_ROUNDS; i++, round++) {
+					for (k = 0; k < 8; k++)
+						p[k] = (unsigned char)(round >> (8 * k));
+					p += L;
+				}
+			}
+			data = &lane[j].stream[16 * lane[j].blk];
+			for (i = 0; i < 16; i++)
+				block[STATE_POS(j, i)] = JOHNSWAP(data[i]);
+		}
+		SSESHA256body((__m128i*)block, state, state, SSEi_MIXED_IN|SSEi_RELOAD);
+		for (j = 0; j < n; j++) {
+			if (lane[j].period == periods ||
+			    ++lane[j].blk < lane[j].RawLength / 2)
+				continue;
+			lane[j].blk = 0;
+			if (++lane[j].period == periods) {
+				for (i = 0; i < 8; i++)
+					final_state[STATE_POS(j, i)] = state[STATE_POS(j, i)];
+				active--;
+			}
+		}
+	}
+	MEM_FREE(streams);
+
+	/* The message is block aligned, so the padding is a block of its own */
+	memset(block, 0, sizeof(block));
+	for (j = 0; j < n; j++) {
+		unsigned long long bits = (unsigned long long)periods *
+			PERIOD_ROUNDS * lane[j].RawLength * 8;
+
+		block[STATE_POS(j, 0)] = 0x80000000;
+		block[STATE_POS(j, 14)] = (ARCH_WORD_32)(bits >> 32);
+		block[STATE_POS(j, 15)] = (ARCH_WORD_32)bits;
+	}
+	SSESHA256body((__m128i*)block, state, final_state, SSEi_MIXED_IN|SSEi_RELOAD);
+	for (j = 0; j < n; j++)
+		for (i = 0; i < 8; i++)
+			((ARCH_WORD_32*)derived_key[order[j]])[i] =
+				JOHNSWAP(state[STATE_POS(j, i)]);
+}
+#undef PERIOD_ROUNDS
+#undef STATE_POS
+#endif
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int index = 0;
+#ifdef SEVENZIP_SIMD
+	int loops = (count + NBKEYS - 1) / NBKEYS;
+	int nsurv = 0;
+
+	for (index = 0; index < count; index++)
+		saved_len[index] = sevenzip_utf16((UTF8*)saved_key[index],
+		                                  saved_utf16[index]);
+	sort_by_length(count);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < loops; index++)
+		sevenzip_kdf_sse(&key_order[index * NBKEYS],
+		                 MIN(NBKEYS, count - index * NBKEYS));
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < count; index++)
+		cracked[index] = sevenzip_padding_check(derived_key[index]);
+
+	/* only keys that survived the padding check get the full decrypt */
+	for (index = 0; index < count; index++)
+		if (cracked[index])
+			survivors[nsurv++] = index;
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < nsurv; index++)
+		cracked[survivors[index]] =
+			(sevenzip_decrypt(derived_key[survivors[index]],
+			                  cur_salt->data) == 0);
+#else
 #ifdef _OPENMP
 #pragma omp parallel for
 	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
@@ -357,11 +585,13 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		sevenzip_kdf((unsigned char*)saved_key[index], master);
 
 		/* do decryption and checks */
-		if(sevenzip_decrypt(master, cur_salt->data) == 0)
+		if (sevenzip_padding_check(master) &&
+		    sevenzip_decrypt(master, cur_salt->data) == 0)
 			cracked[index] = 1;
 		else
 			cracked[index] = 0;
 	}
+#endif
 	return count;
 }
 
@@ -321,6 +321,58 @@ typedef struct {
 	(dst).f = vec_sel((a).f, (b).f, (vector bool int)(c).f); \
 	(dst).g = vec_sel((a).g, (b).g, (vector bool int)(c).g)
 
+#elif defined(__AVX512F__) && DES_BS_DEPTH == 512
+#include <immintrin.h>
+
+typedef __m512i vtype;
+
+#define vst(dst, ofs, src) \
+	_mm512_store_si512((vtype *)((DES_bs_vector *)&(dst) + (ofs)), (src))
+
+#define vxorf(a, b) \
+	_mm512_xor_si512((a), (b))
+
+#define vnot(dst, a) \
+	(dst) = _mm512_ternarylogic_epi64((a), (a), (a), 0x55)
+#define vand(dst, a, b) \
+	(dst) = _mm512_and_si512((a), (b))
+#define vor(dst, a, b) \
+	(dst) = _mm512_or_si512((a), (b))
+#define vandn(dst, a, b) \
+	(dst) = _mm512_andnot_si512((b), (a))
+/* (c & b) | (~c & a) as one vpternlogq */
+#define vsel(dst, a, b, c) \
+	(dst) = _mm512_ternarylogic_epi64((c), (b), (a), 0xCA)
+
+#define vshl(dst, src, shift) \
+	(dst) = _mm512_slli_epi64((src), (shift))
+#define vshr(dst, src, shift) \
+	(dst) = _mm512_srli_epi64((src), (shift))
+
+#elif defined(__AVX2__) && DES_BS_DEPTH == 256 && !defined(DES_BS_NO_AVX256)
+#include <immintrin.h>
+
+/* AVX2 has the 256-bit integer bitwise ops and shifts that AVX lacks */
+typedef __m256i vtype;
+
+#define vst(dst, ofs, src) \
+	_mm256_store_si256((vtype *)((DES_bs_vector *)&(dst) + (ofs)), (src))
+
+#define vxorf(a, b) \
+	_mm256_xor_si256((a), (b))
+
+#define vand(dst, a, b) \
+	(dst) = _mm256_and_si256((a), (b))
+#define vor(dst, a, b) \
+	(dst) = _mm256_or_si256((a), (b))
+#define vandn(dst, a, b) \
+	(dst) = _mm256_andnot_si256((b), (a))
+
+#define vshl(dst, src, shift) \
+	(dst) = _mm256_slli_epi64((src), (shift))
+#define vshr(dst, src, shift) \
+	(dst) = _mm256_srli_epi64((src), (shift))
+
 #elif defined(__AVX__) && DES_BS_DEPTH == 256 && !defined(DES_BS_NO_AVX256)
 #include <immintrin.h>
 
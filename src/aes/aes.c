@@ -41,3 +41,123 @@ const char *get_AES_type_string() { if (using_aes_asm()) return "AES-NI"; return
 #include "aes_func.h"
 
 #undef FUNC
+
+/*
+ * Iterated AES-256 ECB (KeePass style key transform). With AES-NI, eight
+ * independent blocks are kept in flight so the aesenc latency is hidden;
+ * a single block chain would leave the unit idle most of the time. This
+ * does not need yasm, so we detect the CPU support at run-time ourselves.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define AES_ITER_NI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+
+#define AES_TARGET __attribute__((target("sse2,aes")))
+
+#define KEY_256_STEP_1(rcon, n)	  \
+	t2 = _mm_aeskeygenassist_si128(t3, rcon); \
+	t2 = _mm_shuffle_epi32(t2, 0xff); \
+	t4 = _mm_slli_si128(t1, 4); t1 = _mm_xor_si128(t1, t4); \
+	t4 = _mm_slli_si128(t4, 4); t1 = _mm_xor_si128(t1, t4); \
+	t4 = _mm_slli_si128(t4, 4); t1 = _mm_xor_si128(t1, t4); \
+	ks[n] = t1 = _mm_xor_si128(t1, t2);
+
+#define KEY_256_STEP_2(n)	  \
+	t2 = _mm_aeskeygenassist_si128(t1, 0); \
+	t2 = _mm_shuffle_epi32(t2, 0xaa); \
+	t4 = _mm_slli_si128(t3, 4); t3 = _mm_xor_si128(t3, t4); \
+	t4 = _mm_slli_si128(t4, 4); t3 = _mm_xor_si128(t3, t4); \
+	t4 = _mm_slli_si128(t4, 4); t3 = _mm_xor_si128(t3, t4); \
+	ks[n] = t3 = _mm_xor_si128(t3, t2);
+
+static AES_TARGET void ni_key_256(unsigned char *key, __m128i *ks)
+{
+	__m128i t1, t2, t3, t4;
+
+	ks[0] = t1 = _mm_loadu_si128((__m128i*)key);
+	ks[1] = t3 = _mm_loadu_si128((__m128i*)(key + 16));
+	KEY_256_STEP_1(0x01, 2); KEY_256_STEP_2(3);
+	KEY_256_STEP_1(0x02, 4); KEY_256_STEP_2(5);
+	KEY_256_STEP_1(0x04, 6); KEY_256_STEP_2(7);
+	KEY_256_STEP_1(0x08, 8); KEY_256_STEP_2(9);
+	KEY_256_STEP_1(0x10, 10); KEY_256_STEP_2(11);
+	KEY_256_STEP_1(0x20, 12); KEY_256_STEP_2(13);
+	KEY_256_STEP_1(0x40, 14);
+}
+
+#undef KEY_256_STEP_1
+#undef KEY_256_STEP_2
+
+#define AES_LANES 8
+
+static AES_TARGET void ni_AES_enc256_ECB_iter(unsigned char *data, unsigned char *key, size_t num_blocks, size_t count)
+{
+	__m128i ks[15], b[AES_LANES];
+	size_t i, n;
+	int j, r;
+
+	ni_key_256(key, ks);
+	for (; num_blocks; num_blocks -= n, data += 16 * n) {
+		n = num_blocks < AES_LANES ? num_blocks : AES_LANES;
+		for (j = 0; j < n; j++)
+			b[j] = _mm_loadu_si128((__m128i*)(data + 16 * j));
+		if (n == AES_LANES) {
+			__m128i b0 = b[0], b1 = b[1], b2 = b[2], b3 = b[3];
+			__m128i b4 = b[4], b5 = b[5], b6 = b[6], b7 = b[7];
+
+#define AES_8(op, k) \
+	b0 = op(b0, k); b1 = op(b1, k); b2 = op(b2, k); b3 = op(b3, k); \
+	b4 = op(b4, k); b5 = op(b5, k); b6 = op(b6, k); b7 = op(b7, k);
+			for (i = 0; i < count; i++) {
+				AES_8(_mm_xor_si128, ks[0]);
+				for (r = 1; r < 14; r++) {
+					AES_8(_mm_aesenc_si128, ks[r]);
+				}
+				AES_8(_mm_aesenclast_si128, ks[14]);
+			}
+#undef AES_8
+			b[0] = b0; b[1] = b1; b[2] = b2; b[3] = b3;
+			b[4] = b4; b[5] = b5; b[6] = b6; b[7] = b7;
+		} else {
+			for (i = 0; i < count; i++)
+			for (j = 0; j < n; j++) {
+				b[j] = _mm_xor_si128(b[j], ks[0]);
+				for (r = 1; r < 14; r++)
+					b[j] = _mm_aesenc_si128(b[j], ks[r]);
+				b[j] = _mm_aesenclast_si128(b[j], ks[14]);
+			}
+		}
+		for (j = 0; j < n; j++)
+			_mm_storeu_si128((__m128i*)(data + 16 * j), b[j]);
+	}
+}
+
+#undef AES_LANES
+
+static int have_aes_ni(void)
+{
+	unsigned int a, b, c, d;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d))
+		return 0;
+	return (c & (1 << 25)) != 0;
+}
+#endif
+
+aes_fptr_iter get_AES_enc256_ECB_iter() {
+#ifdef AES_ITER_NI
+	if (have_aes_ni())
+		return ni_AES_enc256_ECB_iter;
+#endif
+	return openssl_AES_enc256_ECB_iter;
+}
+
+const char *get_AES_iter_type_string() {
+#ifdef AES_ITER_NI
+	if (have_aes_ni())
+		return "AES-NI";
+#endif
+	return "AES";
+}
@@ -32,6 +32,14 @@ typedef void (*aes_fptr_ctr)(unsigned char *, unsigned char *, unsigned char *,
 extern int using_aes_asm();
 extern const char *get_AES_type_string();
 
+// In/out blocks, key, number of blocks, number of times each block is encrypted.
+// This is for key derivations that encrypt the same blocks over and over with
+// one key (eg. KeePass), so the implementation can keep many blocks in flight.
+typedef void (*aes_fptr_iter)(unsigned char *, unsigned char *, size_t, size_t);
+
+extern aes_fptr_iter get_AES_enc256_ECB_iter();
+extern const char *get_AES_iter_type_string();
+
 #if HAVE_AES_ENCRYPT
 
 #include <openssl/aes.h>
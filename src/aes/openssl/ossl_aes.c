@@ -64,6 +64,15 @@ OSSL_CBC_FUNC(256)
 
 #undef OSSL_CBC_FUNC
 
+void openssl_AES_enc256_ECB_iter(unsigned char *data, unsigned char *key, size_t num_blocks, size_t count) {
+	AES_KEY akey;
+	size_t i;
+	aes_key_mgmt(&akey, key, 256, AES_ENCRYPT);
+	for (; num_blocks--; data += AES_BLOCK_SIZE)
+		for (i = 0; i < count; i++)
+			AES_encrypt(data, data, &akey);
+}
+
 // There are other AES functions that could be implemented here.
 
 // Here are the 'low level' ones (some)  These are tied in with aes/aes.h
@@ -10,3 +10,5 @@ OSSL_CBC_FUNC(192)
 OSSL_CBC_FUNC(256)
 
 #undef OSSL_CBC_FUNC
+
+void openssl_AES_enc256_ECB_iter(unsigned char *data, unsigned char *key, size_t num_blocks, size_t count);
@@ -460,6 +460,33 @@ void benchmark_cps(int64 *crypts, clock_t time, char *buffer)
 	}
 }
 
+#ifndef BENCH_BUILD
+/*
+ * With --format=dynamic_N --subformat=dynamic_M, both formats are benchmarked
+ * (see dynamic_Register_formats()), typically a format compiled from its
+ * Expression= next to a hand written one.  Report the first one's speed as a
+ * percentage of the second one's.
+ */
+static int benchmark_compare(void)
+{
+	return options.format && options.subformat &&
+	    !strncmp(options.format, "dynamic_", 8) &&
+	    !strncasecmp(options.subformat, "dynamic_", 8) &&
+	    fmt_list && fmt_list->next && !fmt_list->next->next;
+}
+
+static unsigned int benchmark_ratio(struct bench_results *a,
+	struct bench_results *b)
+{
+	double cps_a, cps_b;
+
+	cps_a = ((double)a->crypts.hi * 4294967296.0 + a->crypts.lo) / a->real;
+	cps_b = ((double)b->crypts.hi * 4294967296.0 + b->crypts.lo) / b->real;
+
+	return (unsigned int)(cps_a * 100.0 / cps_b + 0.5);
+}
+#endif
+
 #ifdef HAVE_MPI
 void gather_results(struct bench_results *results)
 {
@@ -495,6 +522,10 @@ int benchmark_all(void)
 #endif
 	unsigned int total, failed;
 	MEMDBG_HANDLE memHand;
+#ifndef BENCH_BUILD
+	struct bench_results compare_m[2], compare_1[2];
+	int compare = benchmark_compare(), compare_1_too = 1;
+#endif
 
 #ifdef _OPENMP
 	int ompt;
@@ -703,6 +734,15 @@ AGAIN:
 			gather_results(&results_m);
 			gather_results(&results_1);
 		}
+#endif
+#ifndef BENCH_BUILD
+		if (compare && total <= 2) {
+			compare_m[total - 1] = results_m;
+			if (msg_1)
+				compare_1[total - 1] = results_1;
+			else
+				compare_1_too = 0;
+		}
 #endif
 		benchmark_cps(&results_m.crypts, results_m.real, s_real);
 		benchmark_cps(&results_m.crypts, results_m.virtual, s_virtual);
@@ -757,6 +797,20 @@ next:
 #endif
 	} while ((format = format->next) && !event_abort);
 
+#ifndef BENCH_BUILD
+	if (compare && total == 2 && !failed && !event_abort &&
+	    benchmark_time && john_main_process) {
+		printf("%s speed relative to %s:\n",
+		    fmt_list->params.label, fmt_list->next->params.label);
+		printf("%s:\t%u%%\n", msg_m,
+		    benchmark_ratio(&compare_m[0], &compare_m[1]));
+		if (compare_1_too)
+			printf("%s:\t%u%%\n", msg_1,
+			    benchmark_ratio(&compare_1[0], &compare_1[1]));
+		putchar('\n');
+	}
+#endif
+
 	if (failed && total > 1 && !event_abort)
 		printf("%u out of %u tests have FAILED\n", failed, total);
 	else if (total > 1 && !event_abort)
@@ -299,8 +299,14 @@ static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
 		dupe = 0;
 
 	repkey = key = index < 0 ? "" : crk_methods.get_key(index);
-	replogin = pw->login;
-	repuid = pw->uid;
+	/* Without DB_LOGIN these fields are not even allocated */
+	if (crk_db->options->flags & DB_LOGIN) {
+		replogin = pw->login;
+		repuid = pw->uid;
+	} else {
+		replogin = "?";
+		repuid = "";
+	}
 
 	if (index >= 0 && (pers_opts.store_utf8 || pers_opts.report_utf8)) {
 		if (pers_opts.target_enc == UTF_8)
@@ -325,7 +331,8 @@ static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
 		}
 		if (pers_opts.report_utf8) {
 			repkey = utf8key;
-			if (pers_opts.target_enc != UTF_8)
+			if (pers_opts.target_enc != UTF_8 &&
+			    (crk_db->options->flags & DB_LOGIN))
 				replogin = cp_to_utf8_r(pw->login,
 					      utf8login, PLAINTEXT_BUFFER_SIZE);
 		}
@@ -688,6 +695,39 @@ static int crk_process_event(void)
 	return event_abort;
 }
 
+/*
+ * Compare a computed hash against the binaries in the compact database's array
+ * for the group of buckets that its hash value falls in.  Only on a match do
+ * we look up the password hash itself, which may be gone if it's been cracked
+ * already or sit in a neighbouring bucket.
+ */
+static int crk_process_binaries(struct db_salt *salt, int hash, int index)
+{
+	struct db_password *pw;
+	char *binary, *end;
+	int group;
+
+	hash >>= PASSWORD_HASH_SHR;
+	group = hash >> crk_db->binary_shift;
+	binary = crk_db->binaries +
+		crk_db->binary_index[group] * crk_params.binary_size;
+	end = crk_db->binaries +
+		crk_db->binary_index[group + 1] * crk_params.binary_size;
+	for (; binary < end; binary += crk_params.binary_size) {
+		if (!crk_methods.cmp_one(binary, index))
+			continue;
+		for (pw = salt->hash[hash]; pw; pw = pw->next_hash)
+			if (pw->binary == binary)
+				break;
+		if (pw && crk_methods.cmp_exact(crk_methods.source(
+		    pw->source, binary), index))
+		if (crk_process_guess(salt, pw, index))
+			return 1;
+	}
+
+	return 0;
+}
+
 static int crk_password_loop(struct db_salt *salt)
 {
 	struct db_password *pw;
@@ -732,6 +772,15 @@ static int crk_password_loop(struct db_salt *salt)
 			}
 		} while ((pw = pw->next));
 	} else
+	if (crk_db->binary_index) {
+		for (index = 0; index < match; index++) {
+			int hash = salt->index(index);
+			if (salt->bitmap[hash / (sizeof(*salt->bitmap) * 8)] &
+			    (1U << (hash % (sizeof(*salt->bitmap) * 8))))
+			if (crk_process_binaries(salt, hash, index))
+				return 1;
+		}
+	} else
 	for (index = 0; index < match; index++) {
 		int hash = salt->index(index);
 		if (salt->bitmap[hash / (sizeof(*salt->bitmap) * 8)] &
@@ -191,6 +191,9 @@ extern void DynamicFunc__append_keys_pad16(DYNA_OMP_PARAMS);
 extern void DynamicFunc__append_keys_pad20(DYNA_OMP_PARAMS);
 extern void DynamicFunc__crypt_md5(DYNA_OMP_PARAMS);
 extern void DynamicFunc__crypt_md4(DYNA_OMP_PARAMS);
+// fused kernels, only put in place of a whole script by dynamic_SETUP()
+extern void DynamicFunc__fused_len32_salt_crypt_md5(DYNA_OMP_PARAMS);
+extern void DynamicFunc__fused_salt_keys_SHA1_crypt_FINAL(DYNA_OMP_PARAMS);
 extern void DynamicFunc__append_from_last_output_as_base16(DYNA_OMP_PARAMS);
 extern void DynamicFunc__overwrite_from_last_output_as_base16_no_size_fix(DYNA_OMP_PARAMS);
 extern void DynamicFunc__append_salt(DYNA_OMP_PARAMS);
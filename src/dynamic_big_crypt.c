@@ -332,6 +332,9 @@ static inline uint32_t DoMD5_FixBufferLen32(unsigned char *input_buf, int total_
 
 	p = (uint32_t *)input_buf;
 	p[(ret*16)-2] = (total_len<<3);
+	// the clean above may stop short of the last word, which a prior
+	// SHA1/SHA2 crypt of this buffer used for its length.
+	p[(ret*16)-1] = 0;
 	return ret;
 }
 static void DoMD5_crypt_f_sse(void *in, int len[MD5_LOOPS], void *out) {
@@ -515,7 +518,7 @@ void DynamicFunc__MD5_crypt_input1_overwrite_input1(DYNA_OMP_PARAMS){
 		}
 		DoMD5_crypt_sse(input_buf_X86[i>>MD5_X2].x1.b, len, out, x, tid);
 		for (j = 0; j < MD5_LOOPS; ++j)
-			total_len_X86[i+j] = 32;
+			total_len_X86[i+j] = x[j];
 #else
 		unsigned int x = 0;
 		#if (MD5_X2)
@@ -556,7 +559,7 @@ void DynamicFunc__MD5_crypt_input1_overwrite_input2(DYNA_OMP_PARAMS){
 		}
 		DoMD5_crypt_sse(input_buf_X86[i>>MD5_X2].x1.b, len, out, x, tid);
 		for (j = 0; j < MD5_LOOPS; ++j)
-			total_len2_X86[i+j] = 32;
+			total_len2_X86[i+j] = x[j];
 #else
 		unsigned int x = 0;
 		#if (MD5_X2)
@@ -597,7 +600,7 @@ void DynamicFunc__MD5_crypt_input2_overwrite_input1(DYNA_OMP_PARAMS){
 		}
 		DoMD5_crypt_sse(input_buf2_X86[i>>MD5_X2].x1.b, len, out, x, tid);
 		for (j = 0; j < MD5_LOOPS; ++j)
-			total_len_X86[i+j] = 32;
+			total_len_X86[i+j] = x[j];
 #else
 		unsigned int x = 0;
 		#if (MD5_X2)
@@ -638,7 +641,7 @@ void DynamicFunc__MD5_crypt_input2_overwrite_input2(DYNA_OMP_PARAMS){
 		}
 		DoMD5_crypt_sse(input_buf2_X86[i>>MD5_X2].x1.b, len, out, x, tid);
 		for (j = 0; j < MD5_LOOPS; ++j)
-			total_len2_X86[i+j] = 32;
+			total_len2_X86[i+j] = x[j];
 #else
 		unsigned int x = 0;
 		#if (MD5_X2)
@@ -733,7 +736,8 @@ static inline uint32_t DoMD4_FixBufferLen32(unsigned char *input_buf, int total_
 		break;
 	}
 	p = (uint32_t *)input_buf;
-	p[(ret*16)-1] = (total_len<<3);
+	p[(ret*16)-2] = (total_len<<3);
+	p[(ret*16)-1] = 0;
 	return ret;
 }
 static void DoMD4_crypt_f_sse(void *in, int len[MD4_LOOPS], void *out) {
@@ -1133,6 +1137,9 @@ static inline uint32_t DoSHA1_FixBufferLen32(unsigned char *input_buf, int total
 		break;
 	}
 	p = (uint32_t *)input_buf;
+	// the clean above may stop short of this word, which a prior MD4/MD5
+	// crypt of this buffer used for its length.
+	p[(ret*16)-2] = 0;
 	p[(ret*16)-1] = JOHNSWAP(total_len<<3);
 	return ret;
 }
@@ -1539,6 +1546,7 @@ static inline uint32_t DoSHA256_FixBufferLen32(unsigned char *input_buf, int tot
 		break;
 	}
 	p = (uint32_t *)input_buf;
+	p[(ret*16)-2] = 0;
 	p[(ret*16)-1] = JOHNSWAP(total_len<<3);
 	return ret;
 }
@@ -1604,8 +1604,9 @@ static void crypt_all(int count)
 		inc = ((inc + curdat.omp_granularity-1)/curdat.omp_granularity)*curdat.omp_granularity;
 #pragma omp parallel for shared(curdat, inc, m_count)
 		for (j = 0; j < m_count; j += inc) {
-			int i;
+			int i, k;
 			int top=j+inc;
+			int tid = omp_get_thread_num();
 			/* The last block may 'appear' to have more keys than we have in the
 			   entire buffer space.  This is due to the granularity.  If so,
 			   reduce that last one to stop at end of our buffers.  NOT doing
@@ -1616,8 +1617,16 @@ static void crypt_all(int count)
 			// we now run a full script in this thread, using only a subset of
 			// the data, from [j,top)  The next thread will run from [top,top+inc)
 			// each thread will take the next inc values, until we get to m_count
-			for (i = 0; curdat.dynamic_FUNCTIONS[i]; ++i)
-				(*(curdat.dynamic_FUNCTIONS[i]))(j,top,omp_get_thread_num());
+			// Within the thread, the script is run on fused_block keys at a
+			// time, so each primitive finds the data the previous one left
+			// still in cache, instead of streaming all buffers once per step.
+			for (k = j; k < top; k += curdat.fused_block) {
+				int ktop = k + curdat.fused_block;
+				if (ktop > top)
+					ktop = top;
+				for (i = 0; curdat.dynamic_FUNCTIONS[i]; ++i)
+					(*(curdat.dynamic_FUNCTIONS[i]))(k,ktop,tid);
+			}
 		}
 	} else {
 		int i;
@@ -4415,6 +4424,136 @@ void DynamicFunc__crypt_md5(DYNA_OMP_PARAMS)
 		DoMD5(input_buf_X86[i>>MD5_X2], len, crypt_key_X86[i>>MD5_X2]);
 	}
 }
+
+/**************************************************************
+ * Fused kernels.  dynamic_SETUP() puts one of these in place of
+ * the whole script, when the script is exactly the chain that
+ * the kernel implements.  Rather than running each primitive
+ * over all keys in turn, they build and hash one SIMD group of
+ * keys at a time, so the buffers are only touched while hot.
+ *************************************************************/
+
+// md5(md5($p).$s): set_input_len_32, append_salt, crypt_md5.  The
+// md5($p) in base-16 is already in input1 (MGF_KEYS_BASE16_IN1).
+void DynamicFunc__fused_len32_salt_crypt_md5(DYNA_OMP_PARAMS)
+{
+	unsigned i, til;
+#ifdef _OPENMP
+	til = last;
+	i = first;
+#else
+	i = 0;
+	til = m_count;
+#endif
+#ifdef MMX_COEF
+	if (dynamic_use_sse==1) {
+		til = (til+MMX_COEF-1)>>(MMX_COEF>>1);
+		i >>= (MMX_COEF>>1);
+		for (; i < til; i += MD5_SSE_PARA) {
+			unsigned j, k;
+			for (j = i; j < i+MD5_SSE_PARA; ++j) {
+				for (k = 0; k < MMX_COEF; ++k)
+					__SSE_append_string_to_input(input_buf[j].c,k,cursalt,saltlen,32,1);
+#if (MMX_COEF==4)
+				total_len[j] = (32+saltlen)*0x01010101;
+#else
+				total_len[j] = (32+saltlen)*0x10001;
+#endif
+			}
+			SSE_Intrinsics_LoadLens(0, i);
+			SSEmd5body(input_buf[i].c, crypt_key[i].w, NULL, SSEi_MIXED_IN);
+		}
+		return;
+	}
+#endif
+	for (; i < til; ++i) {
+#if MD5_X2
+		unsigned len[2];
+		memcpy(&(input_buf_X86[i>>MD5_X2].x1.b[32]), cursalt, saltlen);
+		total_len_X86[i] = len[0] = 32+saltlen;
+		if (++i == m_count)
+			len[1] = 0;
+		else {
+			memcpy(&(input_buf_X86[i>>MD5_X2].x2.b2[32]), cursalt, saltlen);
+			total_len_X86[i] = len[1] = 32+saltlen;
+		}
+#else
+		unsigned len = 32+saltlen;
+		memcpy(&(input_buf_X86[i>>MD5_X2].x1.b[32]), cursalt, saltlen);
+		total_len_X86[i] = len;
+#endif
+		DoMD5(input_buf_X86[i>>MD5_X2], len, crypt_key_X86[i>>MD5_X2]);
+	}
+}
+
+// sha1($s.$p): clean_input_kwik, append_salt, append_keys,
+// SHA1_crypt_input1_to_output1_FINAL (flat buffers).  The
+// salt.key strings are built in a local buffer, not in input1.
+void DynamicFunc__fused_salt_keys_SHA1_crypt_FINAL(DYNA_OMP_PARAMS)
+{
+	unsigned i, til;
+#ifdef _OPENMP
+	til = last;
+	i = first;
+#else
+	i = 0;
+	til = m_count;
+#endif
+#ifdef SHA1_SSE_PARA
+#define FUSED_SHA1_LANES (SHA1_SSE_PARA*MMX_COEF)
+	for (; i < til; i += FUSED_SHA1_LANES) {
+		JTR_ALIGN(16) unsigned char buf[FUSED_SHA1_LANES*256];
+		JTR_ALIGN(16) ARCH_WORD_32 a[(20*FUSED_SHA1_LANES)/sizeof(ARCH_WORD_32)];
+		ARCH_WORD_32 *out = (ARCH_WORD_32*)crypt_key_X86[i>>MD5_X2].x1.b;
+		unsigned j, k, len, loops[FUSED_SHA1_LANES], bMore, cnt;
+		unsigned char *cp = buf;
+
+		for (j = 0; j < FUSED_SHA1_LANES; ++j, cp += 256) {
+			memcpy(cp, cursalt, saltlen);
+			memcpy(&cp[saltlen], saved_key[i+j], saved_key_len[i+j]);
+			len = saltlen + saved_key_len[i+j];
+			loops[j] = (len + 8) / 64 + 1;
+			cp[len] = 0x80;
+			memset(&cp[len+1], 0, loops[j]*64 - len - 1);
+			((ARCH_WORD_32*)cp)[loops[j]*16-1] = JOHNSWAP(len<<3);
+		}
+		cp = buf;
+		bMore = 1;
+		cnt = 1;
+		while (bMore) {
+			SSESHA1body(cp, a, a, SSEi_FLAT_IN|SSEi_4BUF_INPUT_FIRST_BLK|(cnt==1?0:SSEi_RELOAD));
+			bMore = 0;
+			for (j = 0; j < FUSED_SHA1_LANES; ++j) {
+				if (cnt == loops[j]) {
+					unsigned offx = ((j>>2)*20)+(j&3);
+					for (k = 0; k < 4; ++k)
+						out[(j<<2)+k] = JOHNSWAP(a[(k<<2)+offx]);
+				} else if (cnt < loops[j])
+					bMore = 1;
+			}
+			cp += 64;
+			++cnt;
+		}
+	}
+#undef FUSED_SHA1_LANES
+#else
+	for (; i < til; ++i) {
+		unsigned char crypt_out[20];
+		SHA_CTX ctx;
+		SHA1_Init(&ctx);
+		SHA1_Update(&ctx, cursalt, saltlen);
+		SHA1_Update(&ctx, saved_key[i], saved_key_len[i]);
+		SHA1_Final(crypt_out, &ctx);
+#if MD5_X2
+		if (i & 1)
+			memcpy(crypt_key_X86[i>>MD5_X2].x2.b2, crypt_out, 16);
+		else
+#endif
+		memcpy(crypt_key_X86[i>>MD5_X2].x1.b, crypt_out, 16);
+	}
+#endif
+}
+
 void DynamicFunc__crypt_md4(DYNA_OMP_PARAMS)
 {
 unsigned i, til;
@@ -6812,11 +6951,51 @@ static void dyna_setupOMP(DYNAMIC_Setup *Setup, struct fmt_main *pFmt) {
 		if (isBadOMPFunc(Setup->pFuncs[i]))
 			pFmt->params.flags &= (~FMT_OMP);
 	}
+	// Scripts that are safe to split across threads are, by the same token,
+	// safe to run in smaller blocks of keys, as long as each block is a
+	// multiple of the granularity.
+	curdat.fused_block = ((FUSED_BLOCK_KEYS + curdat.omp_granularity-1) / curdat.omp_granularity) * curdat.omp_granularity;
 	if ((pFmt->params.flags&FMT_OMP)==FMT_OMP && (curdat.pSetup->startFlags&MGF_POOR_OMP)==MGF_POOR_OMP)
 		pFmt->params.flags |= FMT_OMP_BAD;
 }
 #endif
 
+/*
+ * Scripts that a fused kernel implements in one pass.  The script
+ * has to be exactly the chain, with nothing before or after it.
+ */
+static const struct {
+	DYNAMIC_primitive_funcp chain[5];
+	DYNAMIC_primitive_funcp fused;
+} dyna_fused[] = {
+#if ARCH_LITTLE_ENDIAN
+	{ { DynamicFunc__set_input_len_32, DynamicFunc__append_salt, DynamicFunc__crypt_md5 },
+	  DynamicFunc__fused_len32_salt_crypt_md5 },
+#endif
+	{ { DynamicFunc__clean_input_kwik, DynamicFunc__append_salt, DynamicFunc__append_keys,
+	    DynamicFunc__SHA1_crypt_input1_to_output1_FINAL },
+	  DynamicFunc__fused_salt_keys_SHA1_crypt_FINAL },
+};
+
+static void dyna_setup_fused(void) {
+	int i, j;
+
+	// The kernels read the keys from saved_key[], and the salt from
+	// cursalt, just as append_keys and append_salt do.
+	if (!curdat.dynamic_FUNCTIONS || curdat.store_keys_in_input)
+		return;
+	for (i = 0; i < ARRAY_COUNT(dyna_fused); ++i) {
+		for (j = 0; dyna_fused[i].chain[j]; ++j)
+			if (curdat.dynamic_FUNCTIONS[j] != dyna_fused[i].chain[j])
+				break;
+		if (dyna_fused[i].chain[j] || curdat.dynamic_FUNCTIONS[j])
+			continue;
+		curdat.dynamic_FUNCTIONS[0] = dyna_fused[i].fused;
+		curdat.dynamic_FUNCTIONS[1] = NULL;
+		return;
+	}
+}
+
 int dynamic_SETUP(DYNAMIC_Setup *Setup, struct fmt_main *pFmt)
 {
 	int i, j, cnt, cnt2, x;
@@ -7351,6 +7530,7 @@ int dynamic_SETUP(DYNAMIC_Setup *Setup, struct fmt_main *pFmt)
 #ifdef _OPENMP
 	dyna_setupOMP(Setup, pFmt);
 #endif
+	dyna_setup_fused();
 
 	{
 		struct fmt_tests *pfx = mem_alloc_tiny(ARRAY_COUNT(dynamic_tests) * sizeof (struct fmt_tests), MEM_ALIGN_WORD);
@@ -7489,7 +7669,7 @@ static int LoadOneFormat(int idx, struct fmt_main *pFmt)
 
 int dynamic_Register_formats(struct fmt_main **ptr)
 {
-	int count, i, idx, single=-1, wildcard = 0;
+	int count, i, idx, single=-1, compare=-1, wildcard = 0;
 	extern struct options_main options;
 
 	if (options.format && strstr(options.format, "*"))
@@ -7501,6 +7681,11 @@ int dynamic_Register_formats(struct fmt_main **ptr)
 		sscanf(options.format, "dynamic_%d", &single);
 	if (options.format && options.subformat  && !strcmp(options.format, "dynamic") && !strncmp(options.subformat, "dynamic_", 8))
 		sscanf(options.subformat, "dynamic_%d", &single);
+	// --test --format=dynamic_N --subformat=dynamic_M benchmarks both, and
+	// reports their relative speed (see benchmark_all())
+	if (single != -1 && (options.flags & FLG_TEST_CHK) && options.subformat &&
+	    strcmp(options.format, "dynamic") && !strncmp(options.subformat, "dynamic_", 8))
+		sscanf(options.subformat, "dynamic_%d", &compare);
 	if (options.dynamic_bare_hashes_always_valid == 'Y')
 		m_allow_rawhash_fixup = 1;
 	else if (options.dynamic_bare_hashes_always_valid != 'N'  && cfg_get_bool(SECTION_OPTIONS, NULL, "DynamicAlwaysUseBareHashes", 1))
@@ -7511,11 +7696,16 @@ int dynamic_Register_formats(struct fmt_main **ptr)
 		m_allow_rawhash_fixup = 1;
 		if (dynamic_IS_VALID(single, 1) == 0)
 			return 0;
-		pFmts = mem_alloc_tiny(sizeof(pFmts[0]), MEM_ALIGN_WORD);
+		pFmts = mem_alloc_tiny(sizeof(pFmts[0])*2, MEM_ALIGN_WORD);
 		if (!LoadOneFormat(single, pFmts))
 			return 0;
+		nFmts = 1;
+		if (compare != -1 && compare != single &&
+		    dynamic_IS_VALID(compare, 1) == 1 &&
+		    LoadOneFormat(compare, &pFmts[1]))
+			nFmts = 2;
 		*ptr = pFmts;
-		return (nFmts = 1);
+		return nFmts;
 	}
 
 	for (count = i = 0; i < 5000; ++i) {
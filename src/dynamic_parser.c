@@ -29,7 +29,9 @@
  * Then under the new section, add the script.  There are 2 required
  * data types, and 2 optional.  The required are a list of Func=
  * and a list of Test=    Then there is an optional Expression=
- * and an optional list of Flag= items.
+ * and an optional list of Flag= items.  If there are no Func= lines,
+ * the script is compiled from the Expression= (see
+ * dynamic_Compile_Expression() below).
  *
  * Here is an example, showing processing for md5(md5(md5(md5($p))))
  *
@@ -57,6 +59,7 @@
  *
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
@@ -590,6 +593,7 @@ static int nPreloadCnt;
 static int nFuncCnt;
 static char SetupName[128], SetupNameID[128];
 static struct cfg_list *gen_source;
+static char *szExpression;
 
 extern struct options_main options;
 
@@ -884,6 +888,7 @@ int dynamic_LOAD_PARSER_FUNCTIONS_LoadLINE(struct cfg_line *_line)
 		char tmp[256];
 		sprintf(tmp, "%s %s", SetupNameID, &Line[11]);
 		pSetup->szFORMAT_NAME = str_alloc_copy(tmp);
+		szExpression = &Line[11];
 		return 1;
 	}
 	if (c == 'c' && !strncasecmp(Line, "const", 5))
@@ -979,6 +984,427 @@ static int Count_Items(char *Key)
 	return Cnt;
 }
 
+/*
+ * Expression= compiler.  If a section has an Expression= line, but no Func=
+ * lines, the expression is compiled into the script here.  The grammar is:
+ *
+ *   expr := term [ . term ]...
+ *   term := $p | $pass | $s | $salt | $s2 | $u | $user
+ *         | hash(expr) | hash_raw(expr)
+ *
+ * where hash is md5, md4, sha1, sha224, sha256, sha384, sha512, gost,
+ * whirlpool, tiger or ripemd128/160/256/320.  The outer term must be a hash,
+ * and anything following it (i.e. a '(comment)') is only used in the format
+ * name.  hash() appends lower case base16, hash_raw() appends raw binary.
+ *
+ * If all hashes are md5 or md4 base16, and each buffer is known to fit into
+ * a single SIMD block, the interleaved SIMD primitives (crypt_md5, etc) are
+ * used.  Otherwise the script is built from the flat buffer large hash
+ * primitives (which still use SIMD for MD4/MD5/SHA1 where available).  If
+ * the expression starts with md5($p), that is precomputed once per key into
+ * input1 (MGF_KEYS_BASE16_IN1).  Otherwise we first try to leave the keys in
+ * input1 (MGF_KEYS_INPUT) and do all work in input2.  If the expression needs
+ * 2 work buffers, we fall back to a plain script using both.  Use
+ * --verbosity=4 to see the script that was built.
+ */
+#define EXPR_MAX_TERMS 64
+#define EXPR_MAX_FUNCS 128
+
+typedef struct Dynamic_Expr_Hash_t
+{
+	char *name;
+	char *func;
+	int bin_len;
+	unsigned input_flag;
+} Dynamic_Expr_Hash_t;
+
+static Dynamic_Expr_Hash_t Dynamic_Expr_Hash[] =  {
+	{ "md5",       "MD5",       16, 0 },
+	{ "md4",       "MD4",       16, 0 },
+	{ "sha1",      "SHA1",      20, MGF_INPUT_20_BYTE },
+	{ "sha224",    "SHA224",    28, MGF_INPUT_28_BYTE },
+	{ "sha256",    "SHA256",    32, MGF_INPUT_32_BYTE },
+	{ "sha384",    "SHA384",    48, MGF_INPUT_48_BYTE },
+	{ "sha512",    "SHA512",    64, MGF_INPUT_64_BYTE },
+	{ "gost",      "GOST",      32, MGF_INPUT_32_BYTE },
+	{ "whirlpool", "WHIRLPOOL", 64, MGF_INPUT_64_BYTE },
+	{ "tiger",     "Tiger",     24, MGF_INPUT_24_BYTE },
+	{ "ripemd128", "RIPEMD128", 16, 0 },
+	{ "ripemd160", "RIPEMD160", 20, MGF_INPUT_20_BYTE },
+	{ "ripemd256", "RIPEMD256", 32, MGF_INPUT_32_BYTE },
+	{ "ripemd320", "RIPEMD320", 40, MGF_INPUT_40_BYTE },
+	{ NULL, NULL, 0, 0 }};
+
+enum { EXPR_KEY, EXPR_SALT, EXPR_SALT2, EXPR_USER, EXPR_HASH };
+
+// longer names must come before their prefixes.
+static Dynamic_Str_Flag_t Dynamic_Expr_Leaf[] =  {
+	{ "$pass", EXPR_KEY },
+	{ "$p",    EXPR_KEY },
+	{ "$salt", EXPR_SALT },
+	{ "$s2",   EXPR_SALT2 },
+	{ "$s",    EXPR_SALT },
+	{ "$user", EXPR_USER },
+	{ "$u",    EXPR_USER },
+	{ NULL, 0 }};
+
+typedef struct Dynamic_Expr_Term_t
+{
+	int type;
+	int hash, raw;		// EXPR_HASH only
+	int first, cnt;		// inner terms, EXPR_HASH only
+} Dynamic_Expr_Term_t;
+
+static Dynamic_Expr_Term_t ExprTerms[EXPR_MAX_TERMS];
+static int nExprTerms;
+
+static char ExprFuncs[EXPR_MAX_FUNCS][80];
+static int ExprClean[EXPR_MAX_FUNCS];	// buffer cleaned by this step, or 0
+static int nExprFuncs;
+
+// state of input1/input2 while building.  0 unknown, 1 empty, 2 has data
+static int expr_st[3];
+// set if a buffer ever holds anything other than a single base16 hash
+static int expr_var[3];
+// current LargeHash output mode.  0 unknown, 1 base16, 2 raw
+static int expr_mode;
+static int expr_keys_in, expr_b16_in1, expr_simd, expr_has_raw;
+
+static int expr_parse_list(char **pcp, int *first, int *cnt);
+
+static int expr_parse_term(char **pcp, Dynamic_Expr_Term_t *t)
+{
+	char *cp = *pcp;
+	int i, len;
+
+	for (i = 0; Dynamic_Expr_Leaf[i].name; ++i) {
+		len = strlen(Dynamic_Expr_Leaf[i].name);
+		if (!strncmp(cp, Dynamic_Expr_Leaf[i].name, len)) {
+			t->type = Dynamic_Expr_Leaf[i].flag_bit;
+			*pcp = cp + len;
+			return 1;
+		}
+	}
+	for (i = 0; Dynamic_Expr_Hash[i].name; ++i) {
+		len = strlen(Dynamic_Expr_Hash[i].name);
+		if (strncasecmp(cp, Dynamic_Expr_Hash[i].name, len))
+			continue;
+		t->raw = !strncasecmp(&cp[len], "_raw(", 5);
+		if (t->raw) {
+			len += 4;
+			expr_has_raw = 1;
+		}
+		if (cp[len] != '(')
+			continue;
+		cp += len + 1;
+		t->type = EXPR_HASH;
+		t->hash = i;
+		if (!expr_parse_list(&cp, &t->first, &t->cnt) || *cp != ')')
+			return 0;
+		*pcp = cp + 1;
+		return 1;
+	}
+	return 0;
+}
+
+static int expr_parse_list(char **pcp, int *first, int *cnt)
+{
+	Dynamic_Expr_Term_t tmp[EXPR_MAX_TERMS/2];
+	int n = 0;
+
+	for (;;) {
+		if (n == EXPR_MAX_TERMS/2 || !expr_parse_term(pcp, &tmp[n++]))
+			return 0;
+		if (**pcp != '.')
+			break;
+		++*pcp;
+	}
+
+	if (nExprTerms + n > EXPR_MAX_TERMS)
+		return 0;
+	memcpy(&ExprTerms[nExprTerms], tmp, n * sizeof(tmp[0]));
+	*first = nExprTerms;
+	*cnt = n;
+	nExprTerms += n;
+	return 1;
+}
+
+// Can this (inner) list be done with the interleaved SIMD md5/md4 code?
+static int expr_simd_ok(int first, int cnt)
+{
+	int i, nkey = 0, nsalt = 0, fixed = 0;
+
+	for (i = first; i < first + cnt; ++i) {
+		Dynamic_Expr_Term_t *t = &ExprTerms[i];
+
+		switch (t->type) {
+		case EXPR_KEY:
+			++nkey;
+			break;
+		case EXPR_SALT:
+			++nsalt;
+			break;
+		case EXPR_HASH:
+			if (t->raw || (strcmp(Dynamic_Expr_Hash[t->hash].func, "MD5") &&
+			               strcmp(Dynamic_Expr_Hash[t->hash].func, "MD4")))
+				return 0;
+			if (!expr_simd_ok(t->first, t->cnt))
+				return 0;
+			fixed += 32;
+			break;
+		default:
+			return 0;
+		}
+	}
+	// $p is limited to 55-SaltLen in SIMD builds, so $p.$s fits, but
+	// nothing else can be added to it.
+	if (nkey > 1 || nsalt > 1 || (nsalt && !pSetup->SaltLen))
+		return 0;
+	if (nkey)
+		return !fixed;
+	return fixed + (nsalt ? abs(pSetup->SaltLen) : 0) <= 55;
+}
+
+static int expr_emit(const char *name, int clean)
+{
+	if (nExprFuncs == EXPR_MAX_FUNCS)
+		return 0;
+	ExprClean[nExprFuncs] = clean;
+	sprintf(ExprFuncs[nExprFuncs++], "DynamicFunc__%s", name);
+	return 1;
+}
+
+static int expr_clean(int b)
+{
+	expr_st[b] = 1;
+	return expr_emit(b == 1 ? "clean_input" : "clean_input2", b);
+}
+
+static int expr_append_leaf(int type, int b)
+{
+	static char *leaf_func[4][2] = {
+		{ "append_keys", "append_keys2" },
+		{ "append_salt", "append_salt2" },
+		{ "append_2nd_salt", "append_2nd_salt2" },
+		{ "append_userid", "append_userid2" } };
+
+	switch (type) {
+	case EXPR_SALT:
+		pSetup->flags |= MGF_SALTED;
+		break;
+	case EXPR_SALT2:
+		pSetup->flags |= MGF_SALTED2;
+		break;
+	case EXPR_USER:
+		pSetup->flags |= MGF_USERNAME;
+		break;
+	}
+	expr_st[b] = 2;
+	expr_var[b] = 1;
+	if (type == EXPR_KEY && expr_keys_in) {
+		// does not see keys stored in the interleaved SIMD buffer.
+		if (expr_simd)
+			return 0;
+		return expr_emit("append_input2_from_input", 0);
+	}
+	return expr_emit(leaf_func[type][b-1], 0);
+}
+
+// hash the data in buffer s, and append it to (or overwrite) buffer b
+static int expr_crypt(Dynamic_Expr_Term_t *t, int s, int b, int overwrite)
+{
+	char name[80];
+	Dynamic_Expr_Hash_t *h = &Dynamic_Expr_Hash[t->hash];
+
+	if (expr_simd) {
+		static char *from_out[2][2] = {
+			{ "append_from_last_output_as_base16", "append_from_last_output_to_input2_as_base16" },
+			{ "append_from_last_output2_to_input1_as_base16", "append_from_last_output2_as_base16" } };
+
+		sprintf(name, "%s_%s", s == 1 ? "crypt" : "crypt2", h->name);
+		if (!expr_emit(name, 0))
+			return 0;
+		if (overwrite && !expr_clean(b))
+			return 0;
+		expr_st[b] = 2;
+		return expr_emit(from_out[s-1][b-1], 0);
+	}
+	if (expr_mode != 1 + t->raw) {
+		expr_mode = 1 + t->raw;
+		if (!expr_emit(t->raw ? "LargeHash_OUTMode_raw" : "LargeHash_OUTMode_base16", 0))
+			return 0;
+	}
+	sprintf(name, "%s_crypt_input%d_%s_input%d", h->func, s,
+	        overwrite ? "overwrite" : "append", b);
+	expr_st[b] = 2;
+	return expr_emit(name, 0);
+}
+
+static int expr_gen_list(int first, int cnt, int b);
+
+static int expr_gen_hash(Dynamic_Expr_Term_t *t, int b)
+{
+	int overwrite = (expr_st[b] != 2), s;
+
+	if (!overwrite || t->raw)
+		expr_var[b] = 1;
+	if (expr_keys_in && t->cnt == 1 && ExprTerms[t->first].type == EXPR_KEY)
+		s = 1;
+	else if (overwrite && !(b == 1 && expr_keys_in)) {
+		// nothing in b we need to keep, so build the data right there.
+		s = b;
+		expr_st[b] = 0;
+		if (!expr_gen_list(t->first, t->cnt, s))
+			return 0;
+	} else {
+		s = 3 - b;
+		// input1 holds the keys, or the other buffer is still in use.
+		if ((s == 1 && expr_keys_in) || expr_st[s] == 2)
+			return 0;
+		expr_st[s] = 0;
+		if (!expr_gen_list(t->first, t->cnt, s))
+			return 0;
+	}
+	if (!expr_crypt(t, s, b, overwrite))
+		return 0;
+	if (s != b)
+		expr_st[s] = 0;
+	return 1;
+}
+
+static int expr_gen_list(int first, int cnt, int b)
+{
+	int i;
+
+	// a leading hash overwrites b, so it does not need a clean first.
+	if (expr_st[b] == 0 && ExprTerms[first].type != EXPR_HASH && !expr_clean(b))
+		return 0;
+	for (i = first; i < first + cnt; ++i) {
+		if (ExprTerms[i].type == EXPR_HASH) {
+			if (!expr_gen_hash(&ExprTerms[i], b))
+				return 0;
+		} else if (!expr_append_leaf(ExprTerms[i].type, b))
+			return 0;
+	}
+	return 1;
+}
+
+static int expr_gen(Dynamic_Expr_Term_t *top)
+{
+	char name[80];
+	Dynamic_Expr_Hash_t *h = &Dynamic_Expr_Hash[top->hash];
+	int s, i;
+
+	nExprFuncs = 0;
+	memset(expr_st, 0, sizeof(expr_st));
+	memset(expr_var, 0, sizeof(expr_var));
+	// eLargeOut is not reset between crypt_all calls, so if we ever
+	// switch to raw, we have to set base16 again at the start.
+	expr_mode = expr_has_raw ? 0 : 1;
+
+	if (expr_b16_in1) {
+		// input1 already holds md5($p) in base16 (MGF_KEYS_BASE16_IN1),
+		// so trim off what the last call appended, and add the rest.
+		s = 1;
+		expr_st[1] = 2;
+		if (top->cnt > 1 && (!expr_emit("set_input_len_32", 0) ||
+		                     !expr_gen_list(top->first+1, top->cnt-1, s)))
+			return 0;
+	} else if (expr_keys_in && top->cnt == 1 && ExprTerms[top->first].type == EXPR_KEY)
+		s = 1;
+	else {
+		s = expr_keys_in ? 2 : 1;
+		if (!expr_gen_list(top->first, top->cnt, s))
+			return 0;
+	}
+	if (expr_simd) {
+		if (s == 1)
+			sprintf(name, "crypt_%s", h->name);
+		else
+			sprintf(name, "crypt_%s_in2_to_out1", h->name);
+	} else
+		sprintf(name, "%s_crypt_input%d_to_output1_FINAL", h->func, s);
+	if (!expr_emit(name, 0))
+		return 0;
+
+	// Full clean in the interleaved SIMD buffers, unless the buffer only
+	// ever holds one base16 hash (and so stale bytes are always overwritten).
+	for (i = 0; i < nExprFuncs; ++i)
+		if (ExprClean[i] && !(expr_simd && expr_var[ExprClean[i]]))
+			strcat(ExprFuncs[i], "_kwik");
+	return 1;
+}
+
+static int dynamic_Compile_Expression(int which)
+{
+	Dynamic_Expr_Term_t *top, *t;
+	char *cp = szExpression;
+	int first, cnt, i, j, pass, b16_ok;
+	unsigned in_flags = MGF_INPUT_20_BYTE|MGF_INPUT_24_BYTE|MGF_INPUT_28_BYTE|
+		MGF_INPUT_32_BYTE|MGF_INPUT_40_BYTE|MGF_INPUT_48_BYTE|MGF_INPUT_64_BYTE;
+
+	while (*cp == ' ')
+		++cp;
+	nExprTerms = expr_has_raw = 0;
+	if (!expr_parse_list(&cp, &first, &cnt) || cnt != 1 ||
+	    ExprTerms[first].type != EXPR_HASH || (*cp && *cp != ' '))
+		return !fprintf(stderr, "Error, can not parse Expression=%s\n", szExpression);
+	top = &ExprTerms[first];
+
+	expr_simd = !(pSetup->flags & MGF_FLAT_BUFFERS) &&
+		(!pSetup->MaxInputLen || pSetup->MaxInputLen <= 55) &&
+		expr_simd_ok(first, 1);
+	// try md5($p) precomputed in input1, then keys in input1, then neither.
+	t = &ExprTerms[top->first];
+	b16_ok = t->type == EXPR_HASH && !t->raw && t->cnt == 1 &&
+		!strcmp(Dynamic_Expr_Hash[t->hash].func, "MD5") &&
+		ExprTerms[t->first].type == EXPR_KEY;
+	for (pass = b16_ok ? 0 : 1; pass < 3; ++pass) {
+		expr_b16_in1 = (pass == 0);
+		expr_keys_in = (pass == 1);
+		if (expr_gen(top))
+			break;
+	}
+	if (pass == 3)
+		return !fprintf(stderr, "Error, Expression=%s needs more than 2 work buffers, use Func= lines instead\n", szExpression);
+
+	pSetup->pFuncs = mem_alloc_tiny((nExprFuncs+1)*sizeof(DYNAMIC_primitive_funcp), MEM_ALIGN_WORD);
+	for (i = 0; i < nExprFuncs; ++i) {
+		for (j = 0; Dynamic_Predicate[j].name; ++j)
+			if (!strcmp(Dynamic_Predicate[j].name, ExprFuncs[i]))
+				break;
+		if (!Dynamic_Predicate[j].name)
+			return !fprintf(stderr, "Error, Expression=%s needs unknown function %s\n", szExpression, ExprFuncs[i]);
+		pSetup->pFuncs[i] = Dynamic_Predicate[j].func;
+	}
+	pSetup->pFuncs[i] = NULL;
+	nFuncCnt = nExprFuncs;
+
+	if (!expr_simd)
+		pSetup->flags |= MGF_FLAT_BUFFERS;
+	if (expr_keys_in)
+		pSetup->startFlags |= MGF_KEYS_INPUT;
+	if (expr_b16_in1)
+		pSetup->startFlags |= MGF_KEYS_BASE16_IN1;
+	if (!(pSetup->startFlags & in_flags))
+		pSetup->startFlags |= Dynamic_Expr_Hash[top->hash].input_flag;
+
+	if (options.verbosity > 3 && john_main_process) {
+		fprintf(stderr, "[List.Generic:dynamic_%d] compiled from Expression=%s\n", which, szExpression);
+		for (i = 0; Dynamic_Str_Flag[i].name; ++i)
+			if (Dynamic_Str_Flag[i].flag_bit &&
+			    (pSetup->flags & Dynamic_Str_Flag[i].flag_bit) == Dynamic_Str_Flag[i].flag_bit)
+				fprintf(stderr, "Flag=%s\n", Dynamic_Str_Flag[i].name);
+		for (i = 0; Dynamic_Str_sFlag[i].name; ++i)
+			if (Dynamic_Str_sFlag[i].flag_bit &&
+			    (pSetup->startFlags & Dynamic_Str_sFlag[i].flag_bit) == Dynamic_Str_sFlag[i].flag_bit)
+				fprintf(stderr, "Flag=%s\n", Dynamic_Str_sFlag[i].name);
+		for (i = 0; i < nExprFuncs; ++i)
+			fprintf(stderr, "Func=%s\n", ExprFuncs[i]);
+	}
+	return 1;
+}
+
 int dynamic_LOAD_PARSER_FUNCTIONS(int which, struct fmt_main *pFmt)
 {
 	int ret, cnt;
@@ -986,6 +1412,7 @@ int dynamic_LOAD_PARSER_FUNCTIONS(int which, struct fmt_main *pFmt)
 
 	nPreloadCnt = 0;
 	nFuncCnt = 0;
+	szExpression = NULL;
 
 	pSetup = mem_calloc_tiny(sizeof(DYNAMIC_Setup), MEM_ALIGN_NONE);
 
@@ -1053,6 +1480,14 @@ int dynamic_LOAD_PARSER_FUNCTIONS(int which, struct fmt_main *pFmt)
 		gen_line = gen_line->next;
 	}
 
+	// No script given, so build one from the Expression= line.
+	if (!nFuncCnt && szExpression && !dynamic_Compile_Expression(which))
+	{
+		if (john_main_process)
+			fprintf(stderr, "Error compiling section [List."
+			        "Generic:dynamic_%d]\n", which);
+	}
+
 	ret = dynamic_SETUP(pSetup, pFmt);
 
 	return ret;
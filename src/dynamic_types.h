@@ -137,6 +137,9 @@ typedef struct private_subformat_data
 	struct fmt_main *pFmtMain;
 #ifdef _OPENMP
 	int omp_granularity;
+	// number of keys the whole script is run on at a time (within a thread),
+	// so the intermediate buffers stay in cache between primitives.
+	int fused_block;
 #endif
 } private_subformat_data;
 
@@ -218,6 +221,9 @@ typedef struct private_subformat_data
 #endif
 
 #ifdef _OPENMP
+// keys per blocked pass of an FMT_OMP script (rounded up to omp_granularity).
+// Fused kernels (see dyna_fused[]) work one SIMD group at a time anyway.
+# define FUSED_BLOCK_KEYS		128
 # define X86_BLOCK_LOOPS			6144
 # define X86_BLOCK_LOOPSx2			3072
 #else
@@ -67,6 +67,15 @@ static size_t cracked_size;
 
 static encfs_common_custom_salt *cur_salt;
 
+/*
+ * All the files of one EncFS volume share the PBKDF2 parameters, so the
+ * derived keys are kept until the keys or those parameters change, and
+ * salt_compare() sorts such salts next to each other.
+ */
+static unsigned char (*master)[MAX_KEYLENGTH + MAX_IVLENGTH];
+static encfs_common_custom_salt last_salt;
+static int new_keys;
+
 static struct fmt_tests encfs_tests[] = {
 	{"$encfs$192*181474*0*20*f1c413d9a20f7fdbc068c5a41524137a6e3fb231*44*9c0d4e2b990fac0fd78d62c3d2661272efa7d6c1744ee836a702a11525958f5f557b7a973aaad2fd14387b4f", "openwall"},
 	{"$encfs$128*181317*0*20*e9a6d328b4c75293d07b093e8ec9846d04e22798*36*b9e83adb462ac8904695a60de2f3e6d57018ccac2227251d3f8fc6a8dd0cd7178ce7dc3f", "Jupiter"},
@@ -107,6 +116,22 @@ static void init(struct fmt_main *self)
 	any_cracked = 0;
 	cracked_size = sizeof(*cracked) * self->params.max_keys_per_crypt;
 	cracked = mem_calloc_tiny(cracked_size, MEM_ALIGN_WORD);
+	master = mem_calloc_tiny(sizeof(*master) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+}
+
+/* orders salts by their PBKDF2 parameters only */
+static int salt_compare(const void *x, const void *y)
+{
+	const encfs_common_custom_salt *a = x, *b = y;
+
+	if (a->iterations != b->iterations)
+		return a->iterations < b->iterations ? -1 : 1;
+	if (a->keySize + a->ivLength != b->keySize + b->ivLength)
+		return a->keySize + a->ivLength < b->keySize + b->ivLength ? -1 : 1;
+	if (a->saltLen != b->saltLen)
+		return a->saltLen < b->saltLen ? -1 : 1;
+	return memcmp(a->salt, b->salt, a->saltLen);
 }
 
 static void set_salt(void *salt)
@@ -122,6 +147,7 @@ static void encfs_set_key(char *key, int index)
 		len = PLAINTEXT_LENGTH;
 	memcpy(saved_key[index], key, len);
 	saved_key[index][len] = 0;
+	new_keys = 1;
 }
 
 static char *get_key(int index)
@@ -138,55 +164,59 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		any_cracked = 0;
 	}
 
+	if (new_keys || salt_compare(&last_salt, cur_salt)) {
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
 #endif
-	{
-		int i, j;
-		unsigned char master[MAX_KEYS_PER_CRYPT][MAX_KEYLENGTH + MAX_IVLENGTH];
-		unsigned char tmpBuf[sizeof(cur_salt->data)];
-		unsigned int checksum = 0;
-		unsigned int checksum2 = 0;
-		unsigned char out[MAX_KEYS_PER_CRYPT][MAX_KEYLENGTH + MAX_IVLENGTH];
-
+		for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
+		{
 #ifdef MMX_COEF
-		int len[MAX_KEYS_PER_CRYPT];
-		unsigned char *pin[MAX_KEYS_PER_CRYPT], *pout[MAX_KEYS_PER_CRYPT];
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
-			len[i] = strlen(saved_key[i+index]);
-			pin[i] = (unsigned char*)saved_key[i+index];
-			pout[i] = out[i];
-		}
-		pbkdf2_sha1_sse((const unsigned char **)pin, len, cur_salt->salt, cur_salt->saltLen, cur_salt->iterations, pout, cur_salt->keySize + cur_salt->ivLength, 0);
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i)
-			memcpy(master[i], out[i], cur_salt->keySize + cur_salt->ivLength);
+			int len[MAX_KEYS_PER_CRYPT], i;
+			unsigned char *pin[MAX_KEYS_PER_CRYPT], *pout[MAX_KEYS_PER_CRYPT];
+			for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
+				len[i] = strlen(saved_key[i+index]);
+				pin[i] = (unsigned char*)saved_key[i+index];
+				pout[i] = master[i+index];
+			}
+			pbkdf2_sha1_sse((const unsigned char **)pin, len, cur_salt->salt, cur_salt->saltLen, cur_salt->iterations, pout, cur_salt->keySize + cur_salt->ivLength, 0);
 #else
-		pbkdf2_sha1((const unsigned char *)saved_key[index], strlen(saved_key[index]), cur_salt->salt, cur_salt->saltLen, cur_salt->iterations, out[0], cur_salt->keySize + cur_salt->ivLength, 0);
+			pbkdf2_sha1((const unsigned char *)saved_key[index], strlen(saved_key[index]), cur_salt->salt, cur_salt->saltLen, cur_salt->iterations, master[index], cur_salt->keySize + cur_salt->ivLength, 0);
 #if !ARCH_LITTLE_ENDIAN
-		{
-			int i;
-			for (i = 0; i < (cur_salt->keySize + cur_salt->ivLength)/sizeof(ARCH_WORD_32); ++i) {
-				((ARCH_WORD_32*)out[0])[i] = JOHNSWAP(((ARCH_WORD_32*)out[0])[i]);
+			{
+				int i;
+				for (i = 0; i < (cur_salt->keySize + cur_salt->ivLength)/sizeof(ARCH_WORD_32); ++i) {
+					((ARCH_WORD_32*)master[index])[i] = JOHNSWAP(((ARCH_WORD_32*)master[index])[i]);
+				}
 			}
-		}
 #endif
-		memcpy(master[0], out[0], cur_salt->keySize + cur_salt->ivLength);
 #endif
-		for (j = 0; j < MAX_KEYS_PER_CRYPT; ++j) {
-			// First N bytes are checksum bytes.
-			for(i=0; i<KEY_CHECKSUM_BYTES; ++i)
-				checksum = (checksum << 8) | (unsigned int)cur_salt->data[i];
-			memcpy( tmpBuf, cur_salt->data+KEY_CHECKSUM_BYTES, cur_salt->keySize + cur_salt->ivLength );
-			encfs_common_streamDecode(cur_salt, tmpBuf, cur_salt->keySize + cur_salt->ivLength ,checksum, master[j]);
-			checksum2 = encfs_common_MAC_32(cur_salt, tmpBuf,  cur_salt->keySize + cur_salt->ivLength, master[j]);
-			if(checksum2 == checksum) {
-				cracked[index+j] = 1;
+		}
+		memcpy(&last_salt, cur_salt, sizeof(last_salt));
+		new_keys = 0;
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < count; index++)
+	{
+		int i;
+		unsigned char tmpBuf[sizeof(cur_salt->data)];
+		unsigned int checksum = 0;
+		unsigned int checksum2 = 0;
+
+		// First N bytes are checksum bytes.
+		for(i=0; i<KEY_CHECKSUM_BYTES; ++i)
+			checksum = (checksum << 8) | (unsigned int)cur_salt->data[i];
+		memcpy( tmpBuf, cur_salt->data+KEY_CHECKSUM_BYTES, cur_salt->keySize + cur_salt->ivLength );
+		encfs_common_streamDecode(cur_salt, tmpBuf, cur_salt->keySize + cur_salt->ivLength ,checksum, master[index]);
+		checksum2 = encfs_common_MAC_32(cur_salt, tmpBuf,  cur_salt->keySize + cur_salt->ivLength, master[index]);
+		if(checksum2 == checksum) {
+			cracked[index] = 1;
 #ifdef _OPENMP
 #pragma omp atomic
 #endif
-				any_cracked |= 1;
-			}
+			any_cracked |= 1;
 		}
 	}
 	return count;
@@ -248,7 +278,7 @@ struct fmt_main fmt_encfs = {
 			fmt_default_binary_hash
 		},
 		fmt_default_salt_hash,
-		NULL,
+		salt_compare,
 		set_salt,
 		encfs_set_key,
 		get_key,
@@ -52,18 +52,31 @@ john_register_one(&fmt_gpg);
 #include "sha.h"
 #include "sha2.h"
 #include "stdint.h"
+#include "johnswap.h"
+#include "sse-intrinsics.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL        "gpg"
 #define FORMAT_NAME         "OpenPGP / GnuPG Secret Key"
+#ifdef MMX_COEF
+#define NBKEYS              (MMX_COEF * SHA1_SSE_PARA)
+#define ALGORITHM_NAME      "S2K-SHA1 " SHA1_ALGORITHM_NAME
+#else
+#define NBKEYS              1
 #define ALGORITHM_NAME      "32/" ARCH_BITS_STR
+#endif
+/* SHA-NI makes the scalar SHA-256 faster than 4 SSE lanes */
+#if defined(MMX_COEF_SHA256) && !defined(__SHA__)
+#define GPG_SHA256_SIMD
+#endif
 #define BENCHMARK_COMMENT   ""
 #define BENCHMARK_LENGTH    -1001
 #define PLAINTEXT_LENGTH    32
 #define BINARY_SIZE         0
 #define SALT_SIZE		sizeof(struct custom_salt)
-#define MIN_KEYS_PER_CRYPT  1
-#define MAX_KEYS_PER_CRYPT  1
+#define MIN_KEYS_PER_CRYPT  NBKEYS
+#define MAX_KEYS_PER_CRYPT  NBKEYS
+#define MIN(a, b)           (((a) > (b)) ? (b) : (a))
 #define BINARY_ALIGN	sizeof(ARCH_WORD_32)
 // salt has a function pointer.  Use ARCH_WORD
 #define SALT_ALIGN		sizeof(ARCH_WORD)
@@ -91,6 +104,7 @@ static int omp_t = 1;
 #define BIG_ENOUGH 8192
 
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
+static unsigned char (*derived_key)[64];
 static int *cracked;
 static int any_cracked;
 static size_t cracked_size;
@@ -270,6 +284,8 @@ static void init(struct fmt_main *self)
 #endif
 	saved_key = mem_calloc_tiny(sizeof(*saved_key) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	derived_key = mem_calloc_tiny(sizeof(*derived_key) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	any_cracked = 0;
 	cracked_size = sizeof(*cracked) * self->params.max_keys_per_crypt;
 	cracked = mem_calloc_tiny(cracked_size, MEM_ALIGN_WORD);
@@ -729,6 +745,141 @@ static void S2KItSaltedMD5Generator(char *password, unsigned char *key, int leng
 	}
 }
 
+#ifdef MMX_COEF
+/*
+ * Multi-buffer version of the iterated and salted S2K.  Each (candidate,
+ * hash number) pair is a job whose message is hash-number zero bytes and
+ * then the first cur_salt->count bytes of salt||password repeated.  Past
+ * the first block that message repeats every tl / gcd(tl, 64) blocks, so
+ * a job only prebuilds those blocks and cycles through them; the last
+ * partial block and the SHA padding go in a separate tail.  The jobs of
+ * one salt differ in length by at most a block, so all lanes stay busy.
+ */
+#define S2K_BLOCKS	(PLAINTEXT_LENGTH + 8 + 1)
+#define S2K_POS(j, w, size) \
+	(((j) / MMX_COEF) * (size) * MMX_COEF + (w) * MMX_COEF + ((j) & (MMX_COEF - 1)))
+
+typedef void (*sse_body_fn)(__m128i*, ARCH_WORD_32*, ARCH_WORD_32*, unsigned);
+
+struct s2k_job {
+	unsigned char stream[64 * S2K_BLOCKS];
+	unsigned char tail[128];
+	unsigned int blocks, total, period, blk;
+	unsigned char *out;
+};
+
+static void s2k_job_init(struct s2k_job *job, char *password, int zeros,
+                         unsigned char *out)
+{
+	unsigned int tl = strlen(password) + 8;
+	unsigned int len = zeros + cur_salt->count;
+	unsigned int a = tl, b = 64, k, pos, rem;
+	unsigned char *last;
+	ARCH_WORD_64 bits = (ARCH_WORD_64)len << 3;
+
+	while (b) {
+		k = a % b;
+		a = b;
+		b = k;
+	}
+	job->period = tl / a;
+	memset(job->stream, 0, zeros);
+	for (k = zeros, pos = 0; k < 64 * (job->period + 1); k++) {
+		job->stream[k] = pos < 8 ? cur_salt->salt[pos] : password[pos - 8];
+		if (++pos == tl)
+			pos = 0;
+	}
+
+	job->blocks = len / 64;
+	rem = len % 64;
+	job->total = job->blocks + (rem < 56 ? 1 : 2);
+	job->blk = 0;
+	job->out = out;
+
+	k = job->blocks;
+	if (k > job->period)
+		k = 1 + (k - 1) % job->period;
+	last = &job->stream[64 * k];
+	memset(job->tail, 0, sizeof(job->tail));
+	memcpy(job->tail, last, rem);
+	job->tail[rem] = 0x80;
+	last = &job->tail[64 * (job->total - job->blocks) - 8];
+	for (k = 8; k--; bits >>= 8)
+		last[k] = (unsigned char)bits;
+}
+
+static void s2k_sse(struct s2k_job *job, int n, sse_body_fn body,
+                    const ARCH_WORD_32 *iv, int words, int size)
+{
+	JTR_ALIGN(16) ARCH_WORD_32 block[NBKEYS * SHA_BUF_SIZ];
+	JTR_ALIGN(16) ARCH_WORD_32 state[NBKEYS * 8];
+	unsigned int b, total = 0;
+	int i, j;
+
+	memset(block, 0, sizeof(block));
+	for (j = 0; j < NBKEYS; j++)
+		for (i = 0; i < words; i++)
+			state[S2K_POS(j, i, words)] = iv[i];
+	for (j = 0; j < n; j++)
+		if (job[j].total > total)
+			total = job[j].total;
+
+	for (b = 0; b < total; b++) {
+		for (j = 0; j < n; j++) {
+			ARCH_WORD_32 *data;
+
+			if (b >= job[j].total)
+				continue;
+			if (b < job[j].blocks) {
+				data = (ARCH_WORD_32*)&job[j].stream[64 * job[j].blk];
+				job[j].blk = job[j].blk == job[j].period ?
+					1 : job[j].blk + 1;
+			} else
+				data = (ARCH_WORD_32*)&job[j].tail[64 * (b - job[j].blocks)];
+			for (i = 0; i < 16; i++)
+				block[S2K_POS(j, i, size)] = JOHNSWAP(data[i]);
+		}
+		body((__m128i*)block, state, state, SSEi_MIXED_IN|SSEi_RELOAD);
+		for (j = 0; j < n; j++)
+			if (b + 1 == job[j].total)
+				for (i = 0; i < words; i++)
+					((ARCH_WORD_32*)job[j].out)[i] =
+						JOHNSWAP(state[S2K_POS(j, i, words)]);
+	}
+}
+
+/* Runs the S2K for all candidates, lanes jobs at a time */
+static void s2k_sse_all(int count, int ks, int digest_len, sse_body_fn body,
+                        const ARCH_WORD_32 *iv, int size, int lanes)
+{
+	int num_hashes = (ks + digest_len - 1) / digest_len;
+	int jobs = count * num_hashes;
+	int loops = (jobs + lanes - 1) / lanes;
+	int index;
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < loops; index++) {
+		struct s2k_job *job = mem_alloc(sizeof(*job) * lanes);
+		int j, n = MIN(lanes, jobs - index * lanes);
+
+		for (j = 0; j < n; j++) {
+			int k = index * lanes + j;
+			int i = k % num_hashes;
+
+			k /= num_hashes;
+			s2k_job_init(&job[j], saved_key[k], i,
+			             derived_key[k] + i * digest_len);
+		}
+		s2k_sse(job, n, body, iv, digest_len / 4, size);
+		MEM_FREE(job);
+	}
+}
+#undef S2K_POS
+#undef S2K_BLOCKS
+#endif
+
 static void *get_salt(char *ciphertext)
 {
 	char *ctcopy = strdup(ciphertext);
@@ -1258,26 +1409,49 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int index = 0;
+	int ks = keySize(cur_salt->cipher_algorithm);
 
 	if (any_cracked) {
 		memset(cracked, 0, cracked_size);
 		any_cracked = 0;
 	}
 
+#ifdef MMX_COEF
+	if (cur_salt->spec == SPEC_ITERATED_SALTED &&
+	    cur_salt->hash_algorithm == HASH_SHA1) {
+		static const ARCH_WORD_32 sha1_iv[5] = {
+			0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+		};
+
+		s2k_sse_all(count, ks, SHA_DIGEST_LENGTH, SSESHA1body, sha1_iv,
+		            SHA_BUF_SIZ, NBKEYS);
+	} else
+#ifdef GPG_SHA256_SIMD
+	if (cur_salt->spec == SPEC_ITERATED_SALTED &&
+	    cur_salt->hash_algorithm == HASH_SHA256) {
+		static const ARCH_WORD_32 sha256_iv[8] = {
+			0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+			0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+		};
+
+		s2k_sse_all(count, ks, SHA256_DIGEST_LENGTH, SSESHA256body,
+		            sha256_iv, 16, MMX_COEF_SHA256);
+	} else
+#endif
+#endif
+	{
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index++)
 #endif
-	{
-		// allocate string2key buffer
-		int res;
-		int ks = keySize(cur_salt->cipher_algorithm);
-		//int ds = digestSize(cur_salt->hash_algorithm);
-		unsigned char keydata[64 * ((32 + 64 - 1) / 64)];
-
-		cur_salt->s2kfun(saved_key[index], keydata, ks);
-		res = check(keydata, ks);
-		if (res) {
+		for (index = 0; index < count; index++)
+			cur_salt->s2kfun(saved_key[index], derived_key[index], ks);
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < count; index++) {
+		if (check(derived_key[index], ks)) {
 			cracked[index] = 1;
 #ifdef _OPENMP
 #pragma omp atomic
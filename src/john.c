@@ -186,6 +186,15 @@ static int exit_status = 0;
 
 static void john_register_one(struct fmt_main *format)
 {
+	/* --test --format=dynamic_N --subformat=dynamic_M compares the two */
+	if (options.format && options.subformat &&
+	    (options.flags & FLG_TEST_CHK) &&
+	    (format->params.flags & FMT_DYNAMIC) &&
+	    !strcasecmp(options.subformat, format->params.label)) {
+		fmt_register(format);
+		return;
+	}
+
 	if (options.format) {
 		char *pos = strchr(options.format, '*');
 
@@ -958,7 +967,9 @@ static void john_load(void)
 			options.loader.flags |= DB_WORDS;
 		else
 		if (mem_saving_level) {
-			options.loader.flags &= ~DB_LOGIN;
+			/* --show=left still prints the login names */
+			if (!options.loader.showuncracked)
+				options.loader.flags &= ~DB_LOGIN;
 			options.max_wordfile_memory = 1;
 		}
 
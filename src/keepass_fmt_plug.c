@@ -46,8 +46,9 @@ john_register_one(&fmt_KeePass);
 #define SALT_SIZE		sizeof(struct custom_salt)
 // salt align of 4 was crashing on sparc.  Probably due to the long long value.
 #define SALT_ALIGN		sizeof(long long)
-#define MIN_KEYS_PER_CRYPT	1
-#define MAX_KEYS_PER_CRYPT	1
+/* Two AES blocks per key, so this keeps 8 blocks in flight */
+#define MIN_KEYS_PER_CRYPT	4
+#define MAX_KEYS_PER_CRYPT	4
 
 static struct fmt_tests KeePass_tests[] = {
 	{"$keepass$*1*50000*124*60eed105dac456cfc37d89d950ca846e*72ffef7c0bc3698b8eca65184774f6cd91a9356d338e5140e47e319a87f5e46a*8725bdfd3580cf054a1564dc724aaffe*8e58cc08af2462ddffe2ee39735ad14b15e8cb96dc05ef70d8e64d475eca7bf5*1*752*71d7e65fb3e20b288da8cd582b5c2bc3b63162eef6894e5e92eea73f711fe86e7a7285d5ac9d5ffd07798b83673b06f34180b7f5f3d05222ebf909c67e6580c646bcb64ad039fcdc6f33178fe475739a562dc78012f6be3104da9af69e0e12c2c9c5cd7134bb99d5278f2738a40155acbe941ff2f88db18daf772c7b5fc1855ff9e93ceb35a1db2c30cabe97a96c58b07c16912b2e095e530cc8c24041e7d4876b842f2e7c6df41d08da8c5c4f2402dd3241c3367b6e6e06cd0fa369934e78a6aab1479756a15264af09e3c8e1037f07a58f70f4bf634737ff58725414db10d7b2f61a7ed69878bc0de8bb99f3795bf9980d87992848cd9b9abe0fa6205a117ab1dd5165cf11ffa10b765e8723251ea0907bbc5f3eef8cf1f08bb89e193842b40c95922f38c44d0c3197033a5c7c926a33687aa71c482c48381baa4a34a46b8a4f78715f42eccbc8df80ee3b43335d92bdeb3bb0667cf6da83a018e4c0cd5803004bf6c300b9bee029246d16bd817ff235fcc22bb8c729929499afbf90bf787e98479db5ff571d3d727059d34c1f14454ff5f0a1d2d025437c2d8db4a7be7b901c067b929a0028fe8bb74fa96cb84831ccd89138329708d12c76bd4f5f371e43d0a2d234e5db2b3d6d5164e773594ab201dc9498078b48d4303dd8a89bf81c76d1424084ebf8d96107cb2623fb1cb67617257a5c7c6e56a8614271256b9dd80c76b6d668de4ebe17574ad617f5b1133f45a6d8621e127fcc99d8e788c535da9f557d91903b4e388108f02e9539a681d42e61f8e2f8b06654d4dec308690902a5c76f55b3d79b7c9a0ce994494bc60eff79ff41debc3f2684f40fc912f09035aae022148238ba6f5cfb92f54a5fb28cbb417ff01f39cc464e95929fba5e19be0251bef59879303063e6392c3a49032af3d03d5c9027868d5d6a187698dd75dfc295d2789a0e6cf391a380cc625b0a49f3084f45558ac273b0bbe62a8614db194983b2e207cef7deb1fa6a0bd39b0215d72bf646b599f187ee0009b7b458bb4930a1aea55222099446a0250a975447ff52", "openwall"},
@@ -64,6 +65,7 @@ static struct fmt_tests KeePass_tests[] = {
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static int any_cracked, *cracked;
 static size_t cracked_size;
+static aes_fptr_iter aes_iter;
 
 static struct custom_salt {
 	int version;
@@ -83,84 +85,74 @@ static struct custom_salt {
 	int algorithm; // 1 for Twofish
 } *cur_salt;
 
-static void transform_key(char *masterkey, struct custom_salt *csp, unsigned char *final_key)
+static void transform_key(int index, struct custom_salt *csp, unsigned char (*final_key)[32])
 {
-        // First, hash the masterkey
 	SHA256_CTX ctx;
-	unsigned char hash[32];
+	unsigned char hash[MAX_KEYS_PER_CRYPT][32];
 	unsigned char temphash[32];
 	int i;
-	AES_KEY akey;
-	SHA256_Init(&ctx);
-	SHA256_Update(&ctx, masterkey, strlen(masterkey));
-	SHA256_Final(hash, &ctx);
-	if(csp->version == 2) {
+
+	for (i = 0; i < MAX_KEYS_PER_CRYPT; i++) {
+		char *masterkey = saved_key[index + i];
+
+	        // First, hash the masterkey
 		SHA256_Init(&ctx);
-		SHA256_Update(&ctx, hash, 32);
-		SHA256_Final(hash, &ctx);
-	}
-	memset(&akey, 0, sizeof(AES_KEY));
-	if(AES_set_encrypt_key(csp->transf_randomseed, 256, &akey) < 0) {
-		fprintf(stderr, "AES_set_encrypt_key failed!\n");
-	}
-	/* keyfile handling (only tested for KeePass 1.x files) */
-	if (cur_salt->have_keyfile) {
-		SHA256_CTX composite_ctx;  // for keyfile handling
-		SHA256_CTX keyfile_ctx;
-
-		SHA256_Init(&composite_ctx);
-		SHA256_Update(&composite_ctx, hash, 32);
-
-		if (cur_salt->keyfilesize != 32 && cur_salt->keyfilesize != 64) {
-			SHA256_Init(&keyfile_ctx);
-			SHA256_Update(&keyfile_ctx, cur_salt->keyfile, cur_salt->keyfilesize);
-			SHA256_Final(temphash, &keyfile_ctx);
-		} else if(cur_salt->keyfilesize == 32) {
-			memcpy(temphash, cur_salt->keyfile, 32);
-		} else if (cur_salt->keyfilesize == 64) { /* do hex decoding */
-			abort();  // TODO
+		SHA256_Update(&ctx, masterkey, strlen(masterkey));
+		SHA256_Final(hash[i], &ctx);
+		if(csp->version == 2) {
+			SHA256_Init(&ctx);
+			SHA256_Update(&ctx, hash[i], 32);
+			SHA256_Final(hash[i], &ctx);
 		}
+		/* keyfile handling (only tested for KeePass 1.x files) */
+		if (cur_salt->have_keyfile) {
+			SHA256_CTX composite_ctx;  // for keyfile handling
+			SHA256_CTX keyfile_ctx;
+
+			SHA256_Init(&composite_ctx);
+			SHA256_Update(&composite_ctx, hash[i], 32);
+
+			if (cur_salt->keyfilesize != 32 && cur_salt->keyfilesize != 64) {
+				SHA256_Init(&keyfile_ctx);
+				SHA256_Update(&keyfile_ctx, cur_salt->keyfile, cur_salt->keyfilesize);
+				SHA256_Final(temphash, &keyfile_ctx);
+			} else if(cur_salt->keyfilesize == 32) {
+				memcpy(temphash, cur_salt->keyfile, 32);
+			} else if (cur_salt->keyfilesize == 64) { /* do hex decoding */
+				abort();  // TODO
+			}
 
-		SHA256_Update(&composite_ctx, temphash, 32);
-		SHA256_Final(hash, &composite_ctx);
+			SHA256_Update(&composite_ctx, temphash, 32);
+			SHA256_Final(hash[i], &composite_ctx);
+		}
 	}
 
-        // Next, encrypt the created hash
-	i = csp->key_transf_rounds >> 2;
-	while (i--) {
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-	}
-	i = csp->key_transf_rounds & 3;
-	while (i--) {
-		AES_encrypt(hash, hash, &akey);
-		AES_encrypt(hash+16, hash+16, &akey);
-	}
-        // Finally, hash it again...
-	SHA256_Init(&ctx);
-	SHA256_Update(&ctx, hash, 32);
-	SHA256_Final(hash, &ctx);
-
-        // ...and hash the result together with the randomseed
-	SHA256_Init(&ctx);
-	if(csp->version == 1) {
-		SHA256_Update(&ctx, csp->final_randomseed, 16);
-	}
-	else {
-		SHA256_Update(&ctx, csp->final_randomseed, 32);
+        // Next, encrypt the created hashes, both halves of all keys at once
+	aes_iter(hash[0], csp->transf_randomseed, 2 * MAX_KEYS_PER_CRYPT,
+	         csp->key_transf_rounds);
+
+	for (i = 0; i < MAX_KEYS_PER_CRYPT; i++) {
+	        // Finally, hash it again...
+		SHA256_Init(&ctx);
+		SHA256_Update(&ctx, hash[i], 32);
+		SHA256_Final(hash[i], &ctx);
+
+	        // ...and hash the result together with the randomseed
+		SHA256_Init(&ctx);
+		if(csp->version == 1) {
+			SHA256_Update(&ctx, csp->final_randomseed, 16);
+		}
+		else {
+			SHA256_Update(&ctx, csp->final_randomseed, 32);
+		}
+		SHA256_Update(&ctx, hash[i], 32);
+		SHA256_Final(final_key[i], &ctx);
 	}
-	SHA256_Update(&ctx, hash, 32);
-	SHA256_Final(final_key, &ctx);
 }
 
 static void init(struct fmt_main *self)
 {
+	char *Buf;
 #ifdef _OPENMP
 	int omp_t = 1;
 	omp_t = omp_get_max_threads();
@@ -175,6 +167,11 @@ static void init(struct fmt_main *self)
 	cracked = mem_calloc_tiny(cracked_size, MEM_ALIGN_WORD);
 
 	Twofish_initialise();
+
+	aes_iter = get_AES_enc256_ECB_iter();
+	Buf = mem_alloc_tiny(128, 1);
+	sprintf(Buf, "%s %s", self->params.algorithm_name, get_AES_iter_type_string());
+	self->params.algorithm_name = Buf;
 }
 
 static int valid(char *ciphertext, struct fmt_main *self)
@@ -390,78 +387,85 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index++)
 #endif
+	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
 	{
-		unsigned char final_key[32];
-		unsigned char decrypted_content[LINE_BUFFER_SIZE];
-		SHA256_CTX ctx;
-		unsigned char iv[16];
-		unsigned char out[32];
-		int pad_byte;
-		int datasize;
-		AES_KEY akey;
-		Twofish_key tkey;
-
-		// derive and set decryption key
-		transform_key(saved_key[index], cur_salt, final_key);
-		if (cur_salt->algorithm == 0) {
-			/* AES decrypt cur_salt->contents with final_key */
-			memcpy(iv, cur_salt->enc_iv, 16);
-			memset(&akey, 0, sizeof(AES_KEY));
-			if(AES_set_decrypt_key(final_key, 256, &akey) < 0) {
-				fprintf(stderr, "AES_set_decrypt_key failed in crypt!\n");
+		unsigned char final_keys[MAX_KEYS_PER_CRYPT][32];
+		int i;
+
+		// derive the decryption keys
+		transform_key(index, cur_salt, final_keys);
+		for (i = 0; i < MAX_KEYS_PER_CRYPT; i++)
+		{
+			unsigned char *final_key = final_keys[i];
+			unsigned char decrypted_content[LINE_BUFFER_SIZE];
+			SHA256_CTX ctx;
+			unsigned char iv[16];
+			unsigned char out[32];
+			int pad_byte;
+			int datasize;
+			AES_KEY akey;
+			Twofish_key tkey;
+
+			// set decryption key
+			if (cur_salt->algorithm == 0) {
+				/* AES decrypt cur_salt->contents with final_key */
+				memcpy(iv, cur_salt->enc_iv, 16);
+				memset(&akey, 0, sizeof(AES_KEY));
+				if(AES_set_decrypt_key(final_key, 256, &akey) < 0) {
+					fprintf(stderr, "AES_set_decrypt_key failed in crypt!\n");
+				}
+			} else if (cur_salt->algorithm == 1) {
+				memcpy(iv, cur_salt->enc_iv, 16);
+				memset(&tkey, 0, sizeof(Twofish_key));
+				Twofish_prepare_key(final_key, 32, &tkey);
 			}
-		} else if (cur_salt->algorithm == 1) {
-			memcpy(iv, cur_salt->enc_iv, 16);
-			memset(&tkey, 0, sizeof(Twofish_key));
-			Twofish_prepare_key(final_key, 32, &tkey);
-		}
 
-		if (cur_salt->version == 1 && cur_salt->algorithm == 0) {
-			AES_cbc_encrypt(cur_salt->contents, decrypted_content, cur_salt->contentsize, &akey, iv, AES_DECRYPT);
-			pad_byte = decrypted_content[cur_salt->contentsize-1];
-			datasize = cur_salt->contentsize - pad_byte;
-			SHA256_Init(&ctx);
-			SHA256_Update(&ctx, decrypted_content, datasize);
-			SHA256_Final(out, &ctx);
-			if(!memcmp(out, cur_salt->contents_hash, 32)) {
-				cracked[index] = 1;
+			if (cur_salt->version == 1 && cur_salt->algorithm == 0) {
+				AES_cbc_encrypt(cur_salt->contents, decrypted_content, cur_salt->contentsize, &akey, iv, AES_DECRYPT);
+				pad_byte = decrypted_content[cur_salt->contentsize-1];
+				datasize = cur_salt->contentsize - pad_byte;
+				SHA256_Init(&ctx);
+				SHA256_Update(&ctx, decrypted_content, datasize);
+				SHA256_Final(out, &ctx);
+				if(!memcmp(out, cur_salt->contents_hash, 32)) {
+					cracked[index + i] = 1;
 #ifdef _OPENMP
 #pragma omp atomic
 #endif
-				any_cracked |= 1;
+					any_cracked |= 1;
+				}
 			}
-		}
-		else if (cur_salt->version == 2 && cur_salt->algorithm == 0) {
-			AES_cbc_encrypt(cur_salt->contents, decrypted_content, 32, &akey, iv, AES_DECRYPT);
-			if(!memcmp(decrypted_content, cur_salt->expected_bytes, 32)) {
-				cracked[index] = 1;
+			else if (cur_salt->version == 2 && cur_salt->algorithm == 0) {
+				AES_cbc_encrypt(cur_salt->contents, decrypted_content, 32, &akey, iv, AES_DECRYPT);
+				if(!memcmp(decrypted_content, cur_salt->expected_bytes, 32)) {
+					cracked[index + i] = 1;
 #ifdef _OPENMP
 #pragma omp atomic
 #endif
-				any_cracked |= 1;
-			}
+					any_cracked |= 1;
+				}
 
-		}
-		else if (cur_salt->version == 1 && cur_salt->algorithm == 1) { /* KeePass 1.x with Twofish */
-			int crypto_size;
-			crypto_size = Twofish_Decrypt(&tkey, cur_salt->contents, decrypted_content, cur_salt->contentsize, iv);
-			datasize = crypto_size;  // awesome, right?
-			if (datasize <= cur_salt->contentsize && datasize > 0) {
-				SHA256_Init(&ctx);
-				SHA256_Update(&ctx, decrypted_content, datasize);
-				SHA256_Final(out, &ctx);
-				if(!memcmp(out, cur_salt->contents_hash, 32)) {
-					cracked[index] = 1;
+			}
+			else if (cur_salt->version == 1 && cur_salt->algorithm == 1) { /* KeePass 1.x with Twofish */
+				int crypto_size;
+				crypto_size = Twofish_Decrypt(&tkey, cur_salt->contents, decrypted_content, cur_salt->contentsize, iv);
+				datasize = crypto_size;  // awesome, right?
+				if (datasize <= cur_salt->contentsize && datasize > 0) {
+					SHA256_Init(&ctx);
+					SHA256_Update(&ctx, decrypted_content, datasize);
+					SHA256_Final(out, &ctx);
+					if(!memcmp(out, cur_salt->contents_hash, 32)) {
+						cracked[index + i] = 1;
 #ifdef _OPENMP
 #pragma omp atomic
 #endif
-					any_cracked |= 1;
+						any_cracked |= 1;
+					}
 				}
+			} else {  // KeePass version 2 with Twofish is TODO
+				abort();
 			}
-		} else {  // KeePass version 2 with Twofish is TODO
-			abort();
 		}
 	}
 	return count;
@@ -74,6 +74,14 @@ static int omp_t = 1;
 #endif
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static int *cracked;
+/*
+ * Every item of one keychain shares its PBKDF2 salt, so the derived keys
+ * are kept until the keys or the salt change, and salt_compare() sorts
+ * those salts next to each other.
+ */
+static unsigned char (*master)[32];
+static unsigned char last_salt[SALTLEN];
+static int new_keys;
 
 static struct custom_salt {
 	unsigned char salt[SALTLEN];
@@ -94,6 +102,8 @@ static void init(struct fmt_main *self)
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	cracked = mem_calloc_tiny(sizeof(*cracked) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	master = mem_calloc_tiny(sizeof(*master) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 }
 
 static int valid(char *ciphertext, struct fmt_main *self)
@@ -156,6 +166,12 @@ static void set_salt(void *salt)
 	salt_struct = (struct custom_salt *)salt;
 }
 
+static int salt_compare(const void *x, const void *y)
+{
+	return memcmp(((struct custom_salt *)x)->salt,
+	              ((struct custom_salt *)y)->salt, SALTLEN);
+}
+
 static int kcdecrypt(unsigned char *key, unsigned char *iv, unsigned char *data)
 {
 	unsigned char out[CTLEN];
@@ -193,40 +209,43 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
 	int index = 0;
+
+	if (new_keys || memcmp(last_salt, salt_struct->salt, SALTLEN)) {
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
 #endif
-	{
-		unsigned char master[MAX_KEYS_PER_CRYPT][32];
-		int i;
+		for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
+		{
 #ifdef MMX_COEF
-		int lens[MAX_KEYS_PER_CRYPT];
-		unsigned char *pin[MAX_KEYS_PER_CRYPT], *pout[MAX_KEYS_PER_CRYPT];
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
-			lens[i] = strlen(saved_key[index+i]);
-			pin[i] = (unsigned char*)saved_key[index+i];
-			pout[i] = master[i];
-		}
-		pbkdf2_sha1_sse((const unsigned char**)pin, lens, salt_struct->salt, SALTLEN, 1000, pout, 24, 0);
+			int lens[MAX_KEYS_PER_CRYPT], i;
+			unsigned char *pin[MAX_KEYS_PER_CRYPT], *pout[MAX_KEYS_PER_CRYPT];
+			for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
+				lens[i] = strlen(saved_key[index+i]);
+				pin[i] = (unsigned char*)saved_key[index+i];
+				pout[i] = master[index+i];
+			}
+			pbkdf2_sha1_sse((const unsigned char**)pin, lens, salt_struct->salt, SALTLEN, 1000, pout, 24, 0);
 #else
-		pbkdf2_sha1((unsigned char *)saved_key[index],  strlen(saved_key[index]), salt_struct->salt, SALTLEN, 1000, master[0], 24, 0);
+			pbkdf2_sha1((unsigned char *)saved_key[index],  strlen(saved_key[index]), salt_struct->salt, SALTLEN, 1000, master[index], 24, 0);
 #if !ARCH_LITTLE_ENDIAN
-		{
-			int i;
-			for (i = 0; i < 24/sizeof(ARCH_WORD_32); ++i) {
-				((ARCH_WORD_32*)master[0])[i] = JOHNSWAP(((ARCH_WORD_32*)master[0])[i]);
+			{
+				int i;
+				for (i = 0; i < 24/sizeof(ARCH_WORD_32); ++i) {
+					((ARCH_WORD_32*)master[index])[i] = JOHNSWAP(((ARCH_WORD_32*)master[index])[i]);
+				}
 			}
-		}
 #endif
 #endif
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
-			if(kcdecrypt(master[i], salt_struct->iv, salt_struct->ct) == 0)
-				cracked[index+i] = 1;
-			else
-				cracked[index+i] = 0;
 		}
+		memcpy(last_salt, salt_struct->salt, SALTLEN);
+		new_keys = 0;
 	}
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < count; index++)
+		cracked[index] = !kcdecrypt(master[index], salt_struct->iv, salt_struct->ct);
 	return count;
 }
 
@@ -256,6 +275,7 @@ static void keychain_set_key(char *key, int index)
 		saved_key_length = PLAINTEXT_LENGTH;
 	memcpy(saved_key[index], key, saved_key_length);
 	saved_key[index][saved_key_length] = 0;
+	new_keys = 1;
 }
 
 static char *get_key(int index)
@@ -300,7 +320,7 @@ struct fmt_main fmt_keychain = {
 			fmt_default_binary_hash
 		},
 		fmt_default_salt_hash,
-		NULL,
+		salt_compare,
 		set_salt,
 		keychain_set_key,
 		get_key,
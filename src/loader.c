@@ -153,14 +153,14 @@ void ldr_init_database(struct db_main *db, struct db_options *options)
 	db->salts = NULL;
 
 	db->password_hash = NULL;
-	db->password_hash_func = NULL;
+	db->password_hash_size = db->password_hash_count = 0;
 
 	if (options->flags & DB_CRACKED) {
 		db->salt_hash = NULL;
 
-		db->cracked_hash = mem_alloc(
-			CRACKED_HASH_SIZE * sizeof(struct db_cracked *));
-		memset(db->cracked_hash, 0,
+		db->cracked_hash_size = CRACKED_HASH_SIZE;
+		db->cracked_hash_count = 0;
+		db->cracked_hash = mem_calloc(
 			CRACKED_HASH_SIZE * sizeof(struct db_cracked *));
 	} else {
 		db->salt_hash = mem_alloc(
@@ -179,6 +179,10 @@ void ldr_init_database(struct db_main *db, struct db_options *options)
 
 	db->salt_count = db->password_count = db->guess_count = 0;
 
+	db->binaries = NULL;
+	db->binary_index = NULL;
+	db->binary_shift = 0;
+
 	db->format = NULL;
 }
 
@@ -188,26 +192,176 @@ void ldr_init_database(struct db_main *db, struct db_options *options)
  * not set, and to remove previously-cracked hashes (found in john.pot).  We
  * allocate, use, and free this hash table prior to deciding on the sizes of
  * and allocating the per-salt hash tables to be used while cracking.
+ *
+ * The table is keyed on a hash of the full binary (or of the ciphertext for
+ * formats without one) rather than on a binary_hash() function, and doubles
+ * in size whenever it has as many entries as buckets, so chains stay short
+ * and duplicate detection stays exact however many hashes are loaded.  With
+ * --save-memory=2 and above, it keeps its smaller initial size instead.
  */
 static void ldr_init_password_hash(struct db_main *db)
 {
-	int (*func)(void *binary);
 	int size = PASSWORD_HASH_SIZE_FOR_LDR;
 
 	if (size > 0 && mem_saving_level >= 2)
 		size--;
 
-	do {
-		func = db->format->methods.binary_hash[size];
-		if (func && func != fmt_default_binary_hash)
-			break;
-	} while (--size >= 0);
-	if (size < 0)
-		size = 0;
-	db->password_hash_func = func;
-	size = password_hash_sizes[size] * sizeof(struct db_password *);
-	db->password_hash = mem_alloc(size);
-	memset(db->password_hash, 0, size);
+	db->password_hash_size = password_hash_sizes[size];
+	db->password_hash_count = 0;
+	db->password_hash = mem_calloc(db->password_hash_size *
+	    sizeof(struct db_password *));
+}
+
+static unsigned int ldr_password_hash(struct fmt_main *format,
+	void *binary, char *source)
+{
+	unsigned char *p = binary;
+	size_t size = format->params.binary_size;
+	unsigned int hash = 2166136261U;
+
+	if (!size) {
+		p = (unsigned char *)source;
+		size = strlen(source);
+	}
+
+	while (size--)
+		hash = (hash ^ *p++) * 16777619U;
+
+	return hash ^ (hash >> 15);
+}
+
+static void ldr_grow_password_hash(struct db_main *db)
+{
+	struct fmt_main *format = db->format;
+	struct db_password **old = db->password_hash;
+	struct db_password *current, *next;
+	unsigned int i, hash, old_size = db->password_hash_size;
+
+	db->password_hash_size <<= 1;
+	db->password_hash = mem_calloc(db->password_hash_size *
+	    sizeof(struct db_password *));
+
+	for (i = 0; i < old_size; i++)
+	for (current = old[i]; current; current = next) {
+		next = current->next_hash;
+		hash = ldr_password_hash(format, current->binary,
+		    format->params.binary_size ? NULL :
+		    format->methods.source(current->source, current->binary)) &
+		    (db->password_hash_size - 1);
+		current->next_hash = db->password_hash[hash];
+		db->password_hash[hash] = current;
+	}
+
+	MEM_FREE(old);
+}
+
+/*
+ * Loader-side salt index.  The format's salt_hash() only has SALT_HASH_SIZE
+ * distinct values, so with millions of different salts its buckets get long
+ * and looking up the salt of each new line would take thousands of compares.
+ * This open-addressed table is keyed on a hash of the full salt and doubles
+ * whenever it gets half full, so that the lookup stays O(1) regardless of the
+ * number of salts.  It is only used while loading; the salt_hash[] buckets
+ * are still maintained for ldr_init_salts() and the cracker.
+ */
+static struct db_salt **salt_index;
+static unsigned int salt_index_size, salt_index_count;
+
+static unsigned int ldr_salt_index_hash(struct fmt_main *format, void *salt)
+{
+	unsigned char *p = salt;
+	size_t size = format->params.salt_size;
+	unsigned int hash = 2166136261U;
+
+	if ((format->params.flags & FMT_DYNA_SALT) == FMT_DYNA_SALT) {
+		dyna_salt_john_core *ds = *(dyna_salt_john_core **)salt;
+
+		p = (unsigned char *)ds + ds->dyna_salt.salt_cmp_offset;
+		size = ds->dyna_salt.salt_cmp_size;
+	}
+
+	while (size--)
+		hash = (hash ^ *p++) * 16777619U;
+
+	return hash ^ (hash >> 15);
+}
+
+static void ldr_salt_index_insert(struct db_salt *salt, unsigned int hash)
+{
+	unsigned int i = hash & (salt_index_size - 1);
+
+	while (salt_index[i])
+		i = (i + 1) & (salt_index_size - 1);
+	salt_index[i] = salt;
+}
+
+static void ldr_salt_index_grow(struct fmt_main *format)
+{
+	struct db_salt **old = salt_index;
+	unsigned int i, old_size = salt_index_size;
+
+	salt_index_size = old_size ? old_size << 1 : SALT_HASH_SIZE;
+	salt_index = mem_calloc(salt_index_size * sizeof(struct db_salt *));
+
+	for (i = 0; i < old_size; i++)
+	if (old[i])
+		ldr_salt_index_insert(old[i],
+		    ldr_salt_index_hash(format, old[i]->salt));
+
+	MEM_FREE(old);
+}
+
+static struct db_salt *ldr_salt_index_find(struct fmt_main *format,
+	void *salt, unsigned int hash)
+{
+	unsigned int i = hash & (salt_index_size - 1);
+	struct db_salt *current;
+
+	while ((current = salt_index[i])) {
+		if (!dyna_salt_cmp(current->salt, salt,
+		    format->params.salt_size))
+			return current;
+		i = (i + 1) & (salt_index_size - 1);
+	}
+
+	return NULL;
+}
+
+static void ldr_salt_index_add(struct fmt_main *format,
+	struct db_salt *salt, unsigned int hash)
+{
+	if (++salt_index_count > salt_index_size >> 1)
+		ldr_salt_index_grow(format);
+	ldr_salt_index_insert(salt, hash);
+}
+
+static void ldr_free_salt_index(void)
+{
+	MEM_FREE(salt_index);
+	salt_index_size = salt_index_count = 0;
+}
+
+/*
+ * With a compact database of an unsalted format, the binaries are loaded into
+ * a single array, which ldr_init_binaries() later puts in hash bucket order.
+ * While it grows, the password hashes' binary pointers are rebased onto it.
+ */
+static size_t binary_count, binary_alloc;
+
+static void ldr_grow_binaries(struct db_main *db, struct db_password *list,
+	size_t size)
+{
+	struct db_password *current;
+
+	for (current = list; current; current = current->next)
+		current->binary = (void *)((char *)current->binary -
+			db->binaries);
+
+	binary_alloc = binary_alloc ? binary_alloc << 1 : BINARY_ARRAY_SIZE;
+	db->binaries = mem_realloc(db->binaries, binary_alloc * size);
+
+	for (current = list; current; current = current->next)
+		current->binary = db->binaries + (size_t)current->binary;
 }
 
 static char *ldr_get_field(char **ptr, char field_sep_char)
@@ -631,10 +785,12 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 	char *piece;
 	void *binary, *salt;
 	int salt_hash, pw_hash;
+	unsigned int salt_index_hash;
 	struct db_salt *current_salt, *last_salt;
 	struct db_password *current_pw, *last_pw;
 	struct list_main *words;
 	size_t pw_size, salt_size;
+	int binary_inline, binary_in_array;
 #if FMT_MAIN_VERSION > 11
 	int i;
 #endif
@@ -648,6 +804,7 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 	dyna_salt_init(format);
 
 	words = NULL;
+	binary_inline = binary_in_array = 0;
 
 	if (db->options->flags & DB_WORDS) {
 		pw_size = sizeof(struct db_password);
@@ -658,11 +815,35 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 				sizeof(struct list_main *);
 		else
 			pw_size = sizeof(struct db_password) -
-				(sizeof(char *) + sizeof(struct list_main *));
+				(2 * sizeof(char *) +
+				sizeof(struct list_main *));
 		salt_size = sizeof(struct db_salt) -
 			sizeof(struct db_keys *);
 	}
 
+/*
+ * Without login, uid and words, the source field is the last one we keep.  If
+ * the format can re-create the ciphertext from the binary, we don't need it
+ * either, so we store the binary right there, in the same allocation, rather
+ * than behind a pointer.  Loading huge lists with --save-memory this way uses
+ * a fraction of the memory of a full struct db_password plus its binary.
+ * For unsalted formats, we rather keep all binaries in one array instead.
+ */
+	if (!(db->options->flags & (DB_WORDS | DB_LOGIN)) &&
+	    format->params.binary_size > sizeof(char *)) {
+		if (!format->params.salt_size &&
+		    format->params.binary_align <= MEM_ALIGN_WORD &&
+		    !(format->params.binary_size %
+		    format->params.binary_align))
+			binary_in_array = 1;
+		else
+		if (format->methods.source != fmt_default_source &&
+		    format->params.binary_align <= MEM_ALIGN_WORD) {
+			pw_size += format->params.binary_size - sizeof(char *);
+			binary_inline = 1;
+		}
+	}
+
 	if (!db->password_hash) {
 		ldr_init_password_hash(db);
 		if (cfg_get_bool(SECTION_OPTIONS, NULL,
@@ -678,7 +859,8 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 		piece = format->methods.split(ciphertext, index, format);
 
 		binary = format->methods.binary(piece);
-		pw_hash = db->password_hash_func(binary);
+		pw_hash = ldr_password_hash(format, binary, piece) &
+			(db->password_hash_size - 1);
 
 		if (options.flags & FLG_REJECT_PRINTABLE) {
 			int i = 0;
@@ -711,21 +893,12 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 				if (++collisions <= LDR_HASH_COLLISIONS_MAX)
 					continue;
 
-				if (john_main_process) {
-					if (format->params.binary_size)
-					fprintf(stderr, "Warning: "
-					    "excessive partial hash "
-					    "collisions detected\n%s",
-					    db->password_hash_func !=
-					    fmt_default_binary_hash ? "" :
-					    "(cause: the \"format\" lacks "
-					    "proper binary_hash() function "
-					    "definitions)\n");
-					else
+				if (john_main_process)
 					fprintf(stderr, "Warning: "
-					    "check for duplicates partially "
-					    "bypassed to speedup loading\n");
-				}
+					    "excessive hash collisions "
+					    "detected, check for duplicates "
+					    "partially bypassed to speedup "
+					    "loading\n");
 				skip_dupe_checking = 1;
 				current_pw = NULL; /* no match */
 				break;
@@ -737,13 +910,12 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 		salt = format->methods.salt(piece);
 		dyna_salt_create(salt);
 		salt_hash = format->methods.salt_hash(salt);
+		salt_index_hash = ldr_salt_index_hash(format, salt);
 
-		if ((current_salt = db->salt_hash[salt_hash])) {
-			do {
-				if (!dyna_salt_cmp(current_salt->salt, salt, format->params.salt_size))
-					break;
-			}  while ((current_salt = current_salt->next));
-		}
+		if (!salt_index)
+			ldr_salt_index_grow(format);
+		current_salt = ldr_salt_index_find(format, salt,
+		                                   salt_index_hash);
 
 		if (!current_salt) {
 			last_salt = db->salt_hash[salt_hash];
@@ -771,7 +943,10 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 			if (db->options->flags & DB_WORDS)
 				current_salt->keys = NULL;
 
-			db->salt_count++;
+			ldr_salt_index_add(format, current_salt,
+			                   salt_index_hash);
+
+			current_salt->sequential_id = db->salt_count++;
 		} else
 			dyna_salt_remove(salt);
 
@@ -789,10 +964,19 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 
 /* If we're not going to use the source field for its usual purpose, see if we
  * can pack the binary value in it. */
-		if (format->methods.source != fmt_default_source &&
-		    sizeof(current_pw->source) >= format->params.binary_size)
+		if (binary_inline || (format->methods.source != fmt_default_source &&
+		    sizeof(current_pw->source) >= format->params.binary_size))
 			current_pw->binary = memcpy(&current_pw->source,
 				binary, format->params.binary_size);
+		else
+		if (binary_in_array) {
+			if (binary_count == binary_alloc)
+				ldr_grow_binaries(db, current_pw->next,
+					format->params.binary_size);
+			current_pw->binary = memcpy(db->binaries +
+				binary_count++ * format->params.binary_size,
+				binary, format->params.binary_size);
+		}
 		else
 			current_pw->binary = mem_alloc_copy(binary,
 				format->params.binary_size,
@@ -829,6 +1013,10 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 				current_pw->uid = str_alloc_copy(uid);
 			}
 		}
+
+		if (++db->password_hash_count > db->password_hash_size &&
+		    mem_saving_level < 2)
+			ldr_grow_password_hash(db);
 	}
 }
 
@@ -852,7 +1040,8 @@ static void ldr_load_pot_line(struct db_main *db, char *line)
 	if (format->methods.valid(ciphertext, format) != 1) return;
 	ciphertext = format->methods.split(ciphertext, 0, format);
 	binary = format->methods.binary(ciphertext);
-	hash = db->password_hash_func(binary);
+	hash = ldr_password_hash(format, binary, ciphertext) &
+		(db->password_hash_size - 1);
 
 	if ((current = db->password_hash[hash]))
 	do {
@@ -902,7 +1091,7 @@ static void ldr_init_salts(struct db_main *db)
 		*tail = current;
 		ctr = 0;
 		do {
-			current -> sequential_id = ctr++;
+			ctr++;
 			tail = &current->next;
 		} while ((current = current->next));
 #ifdef DEBUG_HASH
@@ -1263,6 +1452,70 @@ static void ldr_init_hash_for_salt(struct db_main *db, struct db_salt *salt)
 	} while ((current = current->next));
 }
 
+/*
+ * Put the binaries of an unsalted format's hashes in the order of the hash
+ * table buckets, so that the cracker compares computed hashes against
+ * consecutive binaries instead of following the next_hash pointers.  This is
+ * done in place: we only need the new position of each binary on the side.
+ * The binaries of hashes removed since loading end up past the salt's count.
+ */
+static void ldr_init_binaries(struct db_main *db)
+{
+	struct db_salt *salt = db->salts;
+	struct db_password *current;
+	size_t size = db->format->params.binary_size;
+	unsigned int *order, hash, hash_size, index, next, shift;
+	char *tmp;
+
+	if (!db->binaries || !salt || salt->next || salt->hash_size < 0 ||
+	    (hash_size = password_hash_sizes[salt->hash_size] >>
+	    PASSWORD_HASH_SHR) <= 1)
+		return;
+
+/* Index groups of buckets holding a couple of binaries on average, rather than
+ * every bucket, to keep the index smaller than the binaries themselves */
+	shift = 0;
+	while ((hash_size >> shift) > 1 &&
+	    (hash_size >> shift) > salt->count / 2)
+		shift++;
+	db->binary_shift = shift;
+	db->binary_index = mem_alloc_tiny(((hash_size >> shift) + 1) *
+		sizeof(*db->binary_index), MEM_ALIGN_WORD);
+
+	order = mem_alloc(binary_count * sizeof(*order));
+	memset(order, 0xff, binary_count * sizeof(*order));
+
+	index = 0;
+	for (hash = 0; hash < hash_size; hash++) {
+		if (!(hash & ((1U << shift) - 1)))
+			db->binary_index[hash >> shift] = index;
+		for (current = salt->hash[hash]; current;
+		    current = current->next_hash) {
+			order[((char *)current->binary - db->binaries) /
+				size] = index;
+			current->binary = db->binaries + index++ * size;
+		}
+	}
+	db->binary_index[hash_size >> shift] = index;
+
+	for (next = 0; next < binary_count; next++)
+	if (order[next] == ~0U)
+		order[next] = index++;
+
+	tmp = mem_alloc(size);
+	for (index = 0; index < binary_count; index++)
+	while ((next = order[index]) != index) {
+		memcpy(tmp, db->binaries + next * size, size);
+		memcpy(db->binaries + next * size,
+			db->binaries + index * size, size);
+		memcpy(db->binaries + index * size, tmp, size);
+		order[index] = order[next];
+		order[next] = next;
+	}
+	MEM_FREE(tmp);
+	MEM_FREE(order);
+}
+
 /*
  * Decide on whether to use a hash table and on its size for each salt, call
  * ldr_init_hash_for_salt() to allocate and initialize the hash tables.
@@ -1346,6 +1599,7 @@ void ldr_fix_database(struct db_main *db)
 	int total = db->password_count;
 
 	ldr_init_salts(db);
+	ldr_free_salt_index();
 	MEM_FREE(db->password_hash);
 	if (!db->format ||
 	    db->format->methods.salt_hash == fmt_default_salt_hash ||
@@ -1363,6 +1617,7 @@ void ldr_fix_database(struct db_main *db)
 	ldr_sort_salts(db);
 
 	ldr_init_hash(db);
+	ldr_init_binaries(db);
 
 	db->loaded = 1;
 
@@ -1376,24 +1631,49 @@ void ldr_fix_database(struct db_main *db)
 	}
 }
 
-static int ldr_cracked_hash(char *ciphertext)
+static unsigned int ldr_cracked_hash(char *ciphertext)
+{
+	unsigned int hash = 2166136261U;
+	unsigned char *p = (unsigned char *)ciphertext;
+
+	/* ASCII case insensitive */
+	while (*p)
+		hash = (hash ^ (*p++ | 0x20)) * 16777619U;
+
+	return hash ^ (hash >> 15);
+}
+
+/*
+ * Double the number of cracked_hash[] buckets, so that --show keeps finding
+ * its pot records in O(1) however big the pot file is.  Each old chain splits
+ * into buckets i and i + old_size; entries are appended at the tail so chains
+ * keep their order, and the newest pot record for a ciphertext is still the
+ * first one --show finds.
+ */
+static void ldr_grow_cracked_hash(struct db_main *db)
 {
-	unsigned int hash = 0;
-	char *p = ciphertext;
-
-	while (*p) {
-		hash <<= 1;
-		hash += (unsigned char)*p++ | 0x20; /* ASCII case insensitive */
-		if (hash >> (2 * CRACKED_HASH_LOG - 1)) {
-			hash ^= hash >> CRACKED_HASH_LOG;
-			hash &= CRACKED_HASH_SIZE - 1;
+	struct db_cracked **old = db->cracked_hash;
+	struct db_cracked *current, *next, **tail[2];
+	unsigned int i, hash, old_size = db->cracked_hash_size;
+
+	db->cracked_hash_size <<= 1;
+	db->cracked_hash = mem_calloc(db->cracked_hash_size *
+	    sizeof(struct db_cracked *));
+
+	for (i = 0; i < old_size; i++) {
+		tail[0] = &db->cracked_hash[i];
+		tail[1] = &db->cracked_hash[i + old_size];
+		for (current = old[i]; current; current = next) {
+			next = current->next;
+			hash = ldr_cracked_hash(current->ciphertext) &
+			    (db->cracked_hash_size - 1);
+			current->next = NULL;
+			*tail[hash != i] = current;
+			tail[hash != i] = &current->next;
 		}
 	}
 
-	hash ^= hash >> CRACKED_HASH_LOG;
-	hash &= CRACKED_HASH_SIZE - 1;
-
-	return hash;
+	MEM_FREE(old);
 }
 
 static void ldr_show_pot_line(struct db_main *db, char *line)
@@ -1462,7 +1742,8 @@ static void ldr_show_pot_line(struct db_main *db, char *line)
 			return;
 		}
 
-		hash = ldr_cracked_hash(ciphertext);
+		hash = ldr_cracked_hash(ciphertext) &
+			(db->cracked_hash_size - 1);
 
 		last = db->cracked_hash[hash];
 		current = db->cracked_hash[hash] =
@@ -1472,6 +1753,9 @@ static void ldr_show_pot_line(struct db_main *db, char *line)
 
 		current->ciphertext = str_alloc_copy(ciphertext);
 		current->plaintext = str_alloc_copy(line);
+
+		if (++db->cracked_hash_count > db->cracked_hash_size)
+			ldr_grow_cracked_hash(db);
 	}
 }
 
@@ -1550,7 +1834,7 @@ static void ldr_show_pw_line(struct db_main *db, char *line)
 		if (unify)
 			piece = strcpy(mem_alloc(strlen(piece) + 1), piece);
 
-		hash = ldr_cracked_hash(piece);
+		hash = ldr_cracked_hash(piece) & (db->cracked_hash_size - 1);
 
 		if ((current = db->cracked_hash[hash]))
 		do {
@@ -35,11 +35,13 @@ struct db_password {
 
 /* ASCII ciphertext for exact comparison and saving with cracked passwords.
  * Alternatively, when the source() method is non-default this field is either
- * unused or this pointer may be reused to hold the binary value above. */
+ * unused or this pointer may be reused to hold the binary value above.  When
+ * neither DB_LOGIN nor DB_WORDS is set, the struct is allocated only up to this
+ * field and a binary that doesn't fit in the pointer may extend past it. */
 	char *source;
 
 /* Login field from the password file, with ":1" or ":2" appended if the
- * ciphertext was split into two parts. */
+ * ciphertext was split into two parts.  Only allocated with DB_LOGIN. */
 	char *login;
 
 /* uid field from the password file */
@@ -67,7 +69,7 @@ struct db_keys_hash {
 /* The hash table, maps to indices for the list below; -1 means empty bucket */
 	short hash[SINGLE_HASH_SIZE];
 
-/* List of keys with the same hash, allocated as min_keys_per_crypt entries */
+/* List of keys with the same hash, allocated as db_keys.size entries */
 	struct db_keys_hash_entry list[1];
 };
 
@@ -99,7 +101,10 @@ struct db_keys {
 /* Number of recursive calls for this salt */
 	int lock;
 
-/* The keys, allocated as (plaintext_length * min_keys_per_crypt) bytes */
+/* Number of keys the buffer has room for */
+	int size;
+
+/* The keys, allocated as (plaintext_length * size) bytes */
 	char buffer[1];
 };
 
@@ -135,8 +140,9 @@ struct db_salt {
 /* Number of passwords with this salt */
 	int count;
 
-/* Sequential id for a given salt. Sequential id does not change even if some
- * salts are removed during cracking */
+/* Sequential id for a given salt, in the order salts were first seen while
+ * loading.  It does not change even if some salts are removed during cracking,
+ * and is the same on every run with the same input files */
 	int sequential_id;
 
 #if FMT_MAIN_VERSION > 11
@@ -222,15 +228,27 @@ struct db_main {
 	struct db_salt **salt_hash;
 	struct db_password **password_hash;
 
-/* binary_hash function used by the loader itself */
-	int (*password_hash_func)(void *binary);
+/* Number of buckets (a power of 2) and of entries in password_hash[], which
+ * is keyed on the full binary and grows as hashes are loaded */
+	unsigned int password_hash_size, password_hash_count;
 
 /* Cracked passwords */
 	struct db_cracked **cracked_hash;
 
+/* Number of buckets (a power of 2) and of entries in cracked_hash[] */
+	unsigned int cracked_hash_size, cracked_hash_count;
+
 /* Cracked plaintexts list */
 	struct list_main *plaintexts;
 
+/* With a compact database of an unsalted format, the binaries of all loaded
+ * hashes in one array, grouped by the salt's hash table bucket, and the index
+ * of the first binary of each group of (1 << binary_shift) buckets in it (one
+ * more entry marks the end) */
+	char *binaries;
+	unsigned int *binary_index;
+	int binary_shift;
+
 /* Number of salts, passwords and guesses */
 	int salt_count, password_count, guess_count;
 
@@ -79,6 +79,27 @@ void *mem_alloc_func(size_t size
 	return res;
 }
 
+void *mem_realloc_func(void *ptr, size_t size
+#if defined (MEMDBG_ON)
+	, char *file, int line
+#endif
+	)
+{
+	void *res;
+
+#if defined (MEMDBG_ON)
+	res = MEMDBG_realloc(ptr, size, file, line);
+#else
+	res = realloc(ptr, size);
+#endif
+	if (!res && size) {
+		fprintf(stderr, "mem_realloc(): %s trying to allocate %zd bytes\n", strerror(ENOMEM), size);
+		error();
+	}
+
+	return res;
+}
+
 void *mem_calloc_func(size_t size
 #if defined (MEMDBG_ON)
 	, char *file, int line
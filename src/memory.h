@@ -67,6 +67,15 @@ extern unsigned int mem_saving_level;
  * If an error occurs, the function does not return.
  */
 extern void *mem_alloc_func(size_t size
+#if defined (MEMDBG_ON)
+	, char *file, int line
+#endif
+	);
+/*
+ * Changes the size of a block allocated with mem_alloc(), like realloc(3).
+ * If an error occurs, the function does not return.
+ */
+extern void *mem_realloc_func(void *ptr, size_t size
 #if defined (MEMDBG_ON)
 	, char *file, int line
 #endif
@@ -83,6 +92,7 @@ extern void *mem_calloc_func(size_t size
 
 #if defined (MEMDBG_ON)
 #define mem_alloc(a) mem_alloc_func(a,__FILE__,__LINE__)
+#define mem_realloc(a,b) mem_realloc_func(a,b,__FILE__,__LINE__)
 #define mem_calloc(a) mem_calloc_func(a,__FILE__,__LINE__)
 #define mem_alloc_tiny(a,b) mem_alloc_tiny_func(a,b,__FILE__,__LINE__)
 #define mem_calloc_tiny(a,b) mem_calloc_tiny_func(a,b,__FILE__,__LINE__)
@@ -90,6 +100,7 @@ extern void *mem_calloc_func(size_t size
 #define str_alloc_copy(a) str_alloc_copy_func(a,__FILE__,__LINE__)
 #else
 #define mem_alloc(a) mem_alloc_func(a)
+#define mem_realloc(a,b) mem_realloc_func(a,b)
 #define mem_calloc(a) mem_calloc_func(a)
 #define mem_alloc_tiny(a,b) mem_alloc_tiny_func(a,b)
 #define mem_calloc_tiny(a,b) mem_calloc_tiny_func(a,b)
@@ -28,12 +28,31 @@ john_register_one(&fmt_office);
 #include "sha.h"
 #include "sha2.h"
 #include "johnswap.h"
+#include "sse-intrinsics.h"
 #include "office_common.h"
 #include "memdbg.h"
 
 #define FORMAT_LABEL		"Office"
 #define FORMAT_NAME		"2007/2010 (SHA-1) / 2013 (SHA-512), with AES"
+#ifdef MMX_COEF
+#define SHA1_LOOP_CNT		(MMX_COEF * SHA1_SSE_PARA)
+#define SHA1_POS(i, w)		(((i) / MMX_COEF) * SHA_BUF_SIZ * MMX_COEF + (w) * MMX_COEF + ((i) & (MMX_COEF - 1)))
+#ifdef MMX_COEF_SHA512
+#define SHA512_LOOP_CNT		MMX_COEF_SHA512
+#define SHA512_POS(i, w)	(((i) / MMX_COEF_SHA512) * SHA512_BUF_SIZ * MMX_COEF_SHA512 + (w) * MMX_COEF_SHA512 + ((i) & (MMX_COEF_SHA512 - 1)))
+#define ALGORITHM_NAME		"SHA1 " SHA1_ALGORITHM_NAME " / SHA512 " SHA512_ALGORITHM_NAME
+#else
+#define ALGORITHM_NAME		"SHA1 " SHA1_ALGORITHM_NAME " / SHA512 32/" ARCH_BITS_STR " " SHA2_LIB
+#endif
+#else
 #define ALGORITHM_NAME		"32/" ARCH_BITS_STR " " SHA2_LIB
+#endif
+#ifndef SHA1_LOOP_CNT
+#define SHA1_LOOP_CNT		1
+#endif
+#ifndef SHA512_LOOP_CNT
+#define SHA512_LOOP_CNT		1
+#endif
 #define BENCHMARK_COMMENT	""
 #define BENCHMARK_LENGTH	-1
 #define PLAINTEXT_LENGTH	32
@@ -41,8 +60,14 @@ john_register_one(&fmt_office);
 #define SALT_SIZE		sizeof(*cur_salt)
 #define BINARY_ALIGN	4
 #define SALT_ALIGN	sizeof(int)
-#define MIN_KEYS_PER_CRYPT	1
-#define MAX_KEYS_PER_CRYPT	1
+/* Both lane counts are powers of two, so the larger is a multiple of the other */
+#if SHA1_LOOP_CNT > SHA512_LOOP_CNT
+#define MIN_KEYS_PER_CRYPT	SHA1_LOOP_CNT
+#define MAX_KEYS_PER_CRYPT	SHA1_LOOP_CNT
+#else
+#define MIN_KEYS_PER_CRYPT	SHA512_LOOP_CNT
+#define MAX_KEYS_PER_CRYPT	SHA512_LOOP_CNT
+#endif
 
 #undef MIN
 #define MIN(a, b)		(((a) > (b)) ? (b) : (a))
@@ -130,145 +155,245 @@ static unsigned char *DeriveKey(unsigned char *hashValue, unsigned char *X1)
 	return NULL;
 }
 
-static unsigned char* GeneratePasswordHashUsingSHA1(UTF16 *passwordBuf, int passwordBufSize, unsigned char *final)
+/*
+ * H(n) = H(i, H(n-1)) for i = 0 .. spinCount-1, for a whole batch of
+ * MAX_KEYS_PER_CRYPT keys. Each key has i in inputBuf[0] and H(0) in
+ * inputBuf[1..5] on entry, and H(n) in inputBuf[1..5] on return. Every
+ * round is a single fixed-size block, so with SIMD the hashes stay in the
+ * interleaved buffer throughout and the output is written straight back
+ * over the input words.
+ */
+static void IterateSHA1(unsigned int (*inputBuf)[8], int spinCount)
+{
+#ifdef MMX_COEF
+	JTR_ALIGN(16) ARCH_WORD_32 block[SHA1_LOOP_CNT * SHA_BUF_SIZ];
+	int i, j, k;
+
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j += SHA1_LOOP_CNT) {
+		memset(block, 0, sizeof(block));
+		for (k = 0; k < SHA1_LOOP_CNT; k++) {
+			for (i = 1; i < 6; i++)
+				block[SHA1_POS(k, i)] = JOHNSWAP(inputBuf[j + k][i]);
+			block[SHA1_POS(k, 6)] = 0x80000000;
+			block[SHA1_POS(k, 15)] = (0x14 + 0x04) << 3;
+		}
+		for (i = 0; i < spinCount; i++) {
+			ARCH_WORD_32 n = JOHNSWAP(i);
+
+			for (k = 0; k < SHA1_LOOP_CNT; k++)
+				block[SHA1_POS(k, 0)] = n;
+			SSESHA1body((__m128i*)block, &block[MMX_COEF], NULL,
+			            SSEi_MIXED_IN|SSEi_OUTPUT_AS_INP_FMT);
+		}
+		for (k = 0; k < SHA1_LOOP_CNT; k++)
+			for (i = 1; i < 6; i++)
+				inputBuf[j + k][i] = JOHNSWAP(block[SHA1_POS(k, i)]);
+	}
+#else
+	int i, j;
+	SHA_CTX ctx;
+
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j++)
+	for (i = 0; i < spinCount; i++) {
+#if ARCH_LITTLE_ENDIAN
+		*inputBuf[j] = i;
+#else
+		*inputBuf[j] = JOHNSWAP(i);
+#endif
+		// 'append' the previously generated hash to the input buffer
+		SHA1_Init(&ctx);
+		SHA1_Update(&ctx, inputBuf[j], 0x14 + 0x04);
+		SHA1_Final((unsigned char*)&inputBuf[j][1], &ctx);
+	}
+#endif
+}
+
+/* Same as above with SHA-512, and H(0) in inputBuf[1..16] */
+static void IterateSHA512(unsigned int (*inputBuf)[128 / sizeof(int)], int spinCount)
+{
+#ifdef MMX_COEF_SHA512
+	JTR_ALIGN(16) ARCH_WORD_64 block[SHA512_LOOP_CNT * SHA512_BUF_SIZ];
+	JTR_ALIGN(16) ARCH_WORD_64 state[SHA512_LOOP_CNT * 8];
+	int i, j, k;
+
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j += SHA512_LOOP_CNT) {
+		memset(block, 0, sizeof(block));
+		for (k = 0; k < SHA512_LOOP_CNT; k++) {
+			ARCH_WORD_64 *h = (ARCH_WORD_64*)&inputBuf[j + k][0];
+
+			/* The hash is at offset 4, so each state word straddles two input words */
+			for (i = 0; i < 8; i++)
+				state[SHA512_POS(k, i)] = JOHNSWAP64(h[i]) << 32 |
+					JOHNSWAP(inputBuf[j + k][2 * i + 2]);
+			block[SHA512_POS(k, 15)] = (64 + 0x04) << 3;
+		}
+		for (i = 0; i < spinCount; i++) {
+			ARCH_WORD_64 n = (ARCH_WORD_64)JOHNSWAP(i) << 32;
+
+			for (k = 0; k < SHA512_LOOP_CNT; k++) {
+				ARCH_WORD_64 prev = n;
+				int w;
+
+				for (w = 0; w < 8; w++) {
+					ARCH_WORD_64 cur = state[SHA512_POS(k, w)];
+
+					block[SHA512_POS(k, w)] = prev | cur >> 32;
+					prev = cur << 32;
+				}
+				block[SHA512_POS(k, 8)] = prev | 0x80000000;
+			}
+			SSESHA512body((__m128i*)block, state, NULL, SSEi_MIXED_IN);
+		}
+		for (k = 0; k < SHA512_LOOP_CNT; k++) {
+			ARCH_WORD_64 hash[8];
+
+			for (i = 0; i < 8; i++)
+				hash[i] = JOHNSWAP64(state[SHA512_POS(k, i)]);
+			memcpy(&inputBuf[j + k][1], hash, 64);
+		}
+	}
+#else
+	int i, j;
+	SHA512_CTX ctx;
+
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j++)
+	for (i = 0; i < spinCount; i++) {
+#if ARCH_LITTLE_ENDIAN
+		*inputBuf[j] = i;
+#else
+		*inputBuf[j] = JOHNSWAP(i);
+#endif
+		// 'append' the previously generated hash to the input buffer
+		SHA512_Init(&ctx);
+		SHA512_Update(&ctx, inputBuf[j], 64 + 0x04);
+		SHA512_Final((unsigned char*)&inputBuf[j][1], &ctx);
+	}
+#endif
+}
+
+static void GeneratePasswordHashUsingSHA1(int idx, unsigned char (*final)[256])
 {
 	unsigned char hashBuf[20], *key;
 	/* H(0) = H(salt, password)
 	 * hashBuf = SHA1Hash(salt, password);
 	 * create input buffer for SHA1 from salt and unicode version of password */
-	unsigned int inputBuf[(0x14 + 0x04 + 4) / sizeof(int)];
+	unsigned int inputBuf[MAX_KEYS_PER_CRYPT][(28 + 4) / sizeof(int)];
 	unsigned char X1[20];
 	int i;
 	SHA_CTX ctx;
 
-	SHA1_Init(&ctx);
-	SHA1_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
-	SHA1_Update(&ctx, passwordBuf, passwordBufSize);
-	SHA1_Final(hashBuf, &ctx);
+	for (i = 0; i < MAX_KEYS_PER_CRYPT; i++) {
+		SHA1_Init(&ctx);
+		SHA1_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
+		SHA1_Update(&ctx, saved_key[idx + i], saved_len[idx + i]);
+		SHA1_Final(hashBuf, &ctx);
+
+		// Create a byte array of the integer and put at the front of the input buffer
+		// 1.3.6 says that little-endian byte ordering is expected
+		memcpy(&inputBuf[i][1], hashBuf, 20);
+	}
 
 	/* Generate each hash in turn
 	 * H(n) = H(i, H(n-1))
 	 * hashBuf = SHA1Hash(i, hashBuf); */
+	IterateSHA1(inputBuf, MS_OFFICE_2007_ITERATIONS);
 
-	// Create a byte array of the integer and put at the front of the input buffer
-	// 1.3.6 says that little-endian byte ordering is expected
-	memcpy(&inputBuf[1], hashBuf, 20);
-	for (i = 0; i < MS_OFFICE_2007_ITERATIONS; i++) {
-#if ARCH_LITTLE_ENDIAN
-		*inputBuf = i;
-#else
-		*inputBuf = JOHNSWAP(i);
-#endif
-		// 'append' the previously generated hash to the input buffer
+	for (i = 0; i < MAX_KEYS_PER_CRYPT; i++) {
+		// Finally, append "block" (0) to H(n)
+		// hashBuf = SHA1Hash(hashBuf, 0);
+		memset(&inputBuf[i][6], 0, 4);
 		SHA1_Init(&ctx);
-		SHA1_Update(&ctx, inputBuf, 0x14 + 0x04);
-		SHA1_Final((unsigned char*)&inputBuf[1], &ctx);
-	}
-	// Finally, append "block" (0) to H(n)
-	// hashBuf = SHA1Hash(hashBuf, 0);
-	memset(&inputBuf[6], 0, 4);
-	SHA1_Init(&ctx);
-	SHA1_Update(&ctx, &inputBuf[1], 0x14 + 0x04);
-	SHA1_Final(hashBuf, &ctx);
-
-	key = DeriveKey(hashBuf, X1);
+		SHA1_Update(&ctx, &inputBuf[i][1], 0x14 + 0x04);
+		SHA1_Final(hashBuf, &ctx);
 
-	// Should handle the case of longer key lengths as shown in 2.3.4.9
-	// Grab the key length bytes of the final hash as the encrypytion key
-	memcpy(final, key, cur_salt->keySize/8);
+		key = DeriveKey(hashBuf, X1);
 
-	return final;
+		// Should handle the case of longer key lengths as shown in 2.3.4.9
+		// Grab the key length bytes of the final hash as the encrypytion key
+		memcpy(final[i], key, cur_salt->keySize/8);
+	}
 }
 
-static void GenerateAgileEncryptionKey(UTF16 *passwordBuf, int passwordBufSize, int hashSize, unsigned char *hashBuf)
+static void GenerateAgileEncryptionKey(int idx, int hashSize, unsigned char (*hashBuf)[64])
 {
 	/* H(0) = H(salt, password)
 	 * hashBuf = SHA1Hash(salt, password);
 	 * create input buffer for SHA1 from salt and unicode version of password */
-	unsigned int inputBuf[(28 + 4) / sizeof(int)];
-	int i;
+	unsigned int inputBuf[MAX_KEYS_PER_CRYPT][(28 + 4) / sizeof(int)];
+	int i, j;
 	SHA_CTX ctx;
 
-	SHA1_Init(&ctx);
-	SHA1_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
-	SHA1_Update(&ctx, passwordBuf, passwordBufSize);
-	SHA1_Final(hashBuf, &ctx);
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j++) {
+		SHA1_Init(&ctx);
+		SHA1_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
+		SHA1_Update(&ctx, saved_key[idx + j], saved_len[idx + j]);
+		SHA1_Final(hashBuf[j], &ctx);
+
+		// Create a byte array of the integer and put at the front of the input buffer
+		// 1.3.6 says that little-endian byte ordering is expected
+		memcpy(&inputBuf[j][1], hashBuf[j], 20);
+	}
 
 	/* Generate each hash in turn
 	 * H(n) = H(i, H(n-1))
 	 * hashBuf = SHA1Hash(i, hashBuf); */
+	IterateSHA1(inputBuf, cur_salt->spinCount);
 
-	// Create a byte array of the integer and put at the front of the input buffer
-	// 1.3.6 says that little-endian byte ordering is expected
-	memcpy(&inputBuf[1], hashBuf, 20);
-	for (i = 0; i < cur_salt->spinCount; i++) {
-#if ARCH_LITTLE_ENDIAN
-		*inputBuf = i;
-#else
-		*inputBuf = JOHNSWAP(i);
-#endif
-		// 'append' the previously generated hash to the input buffer
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j++) {
+		// Finally, append "block" (0) to H(n)
+		memcpy(&inputBuf[j][6], encryptedVerifierHashInputBlockKey, 8);
 		SHA1_Init(&ctx);
-		SHA1_Update(&ctx, inputBuf, 0x14 + 0x04);
-		SHA1_Final((unsigned char*)&inputBuf[1], &ctx);
-	}
-	// Finally, append "block" (0) to H(n)
-	memcpy(&inputBuf[6], encryptedVerifierHashInputBlockKey, 8);
-	SHA1_Init(&ctx);
-	SHA1_Update(&ctx, &inputBuf[1], 28);
-	SHA1_Final(hashBuf, &ctx);
+		SHA1_Update(&ctx, &inputBuf[j][1], 28);
+		SHA1_Final(hashBuf[j], &ctx);
 
-	// And second "block" (0) to H(n)
-	memcpy(&inputBuf[6], encryptedVerifierHashValueBlockKey, 8);
-	SHA1_Init(&ctx);
-	SHA1_Update(&ctx, &inputBuf[1], 28);
-	SHA1_Final(&hashBuf[32], &ctx);
-
-	// Fix up the size per the spec
-	if (20 < hashSize) { // FIXME: Is this ever true?
-		for(i = 20; i < hashSize; i++) {
-			hashBuf[i] = 0x36;
-			hashBuf[32 + i] = 0x36;
+		// And second "block" (0) to H(n)
+		memcpy(&inputBuf[j][6], encryptedVerifierHashValueBlockKey, 8);
+		SHA1_Init(&ctx);
+		SHA1_Update(&ctx, &inputBuf[j][1], 28);
+		SHA1_Final(&hashBuf[j][32], &ctx);
+
+		// Fix up the size per the spec
+		if (20 < hashSize) { // FIXME: Is this ever true?
+			for(i = 20; i < hashSize; i++) {
+				hashBuf[j][i] = 0x36;
+				hashBuf[j][32 + i] = 0x36;
+			}
 		}
 	}
 }
 
-static void GenerateAgileEncryptionKey512(UTF16 *passwordBuf, int passwordBufSize, unsigned char *hashBuf)
+static void GenerateAgileEncryptionKey512(int idx, unsigned char (*hashBuf)[128])
 {
-	unsigned int inputBuf[128 / sizeof(int)];
-	int i;
+	unsigned int inputBuf[MAX_KEYS_PER_CRYPT][128 / sizeof(int)];
+	int j;
 	SHA512_CTX ctx;
 
-	SHA512_Init(&ctx);
-	SHA512_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
-	SHA512_Update(&ctx, passwordBuf, passwordBufSize);
-	SHA512_Final(hashBuf, &ctx);
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j++) {
+		SHA512_Init(&ctx);
+		SHA512_Update(&ctx, cur_salt->osalt, cur_salt->saltSize);
+		SHA512_Update(&ctx, saved_key[idx + j], saved_len[idx + j]);
+		SHA512_Final(hashBuf[j], &ctx);
 
-	// Create a byte array of the integer and put at the front of the input buffer
-	// 1.3.6 says that little-endian byte ordering is expected
-	memcpy(&inputBuf[1], hashBuf, 64);
-	for (i = 0; i < cur_salt->spinCount; i++) {
-#if ARCH_LITTLE_ENDIAN
-		*inputBuf = i;
-#else
-		*inputBuf = JOHNSWAP(i);
-#endif
-		// 'append' the previously generated hash to the input buffer
+		// Create a byte array of the integer and put at the front of the input buffer
+		// 1.3.6 says that little-endian byte ordering is expected
+		memcpy(&inputBuf[j][1], hashBuf[j], 64);
+	}
+
+	IterateSHA512(inputBuf, cur_salt->spinCount);
+
+	for (j = 0; j < MAX_KEYS_PER_CRYPT; j++) {
+		// Finally, append "block" (0) to H(n)
+		memcpy(&inputBuf[j][68/4], encryptedVerifierHashInputBlockKey, 8);
+		SHA512_Init(&ctx);
+		SHA512_Update(&ctx, &inputBuf[j][1], 64 + 8);
+		SHA512_Final(hashBuf[j], &ctx);
+
+		// And second "block" (0) to H(n)
+		memcpy(&inputBuf[j][68/4], encryptedVerifierHashValueBlockKey, 8);
 		SHA512_Init(&ctx);
-		SHA512_Update(&ctx, inputBuf, 64 + 0x04);
-		SHA512_Final((unsigned char*)&inputBuf[1], &ctx);
+		SHA512_Update(&ctx, &inputBuf[j][1], 64 + 8);
+		SHA512_Final(&hashBuf[j][64], &ctx);
 	}
-	// Finally, append "block" (0) to H(n)
-	memcpy(&inputBuf[68/4], encryptedVerifierHashInputBlockKey, 8);
-	SHA512_Init(&ctx);
-	SHA512_Update(&ctx, &inputBuf[1], 64 + 8);
-	SHA512_Final(hashBuf, &ctx);
-
-	// And second "block" (0) to H(n)
-	memcpy(&inputBuf[68/4], encryptedVerifierHashValueBlockKey, 8);
-	SHA512_Init(&ctx);
-	SHA512_Update(&ctx, &inputBuf[1], 64 + 8);
-	SHA512_Final(&hashBuf[64], &ctx);
 }
 
 static void init(struct fmt_main *self)
@@ -303,37 +428,44 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index++)
 #endif
+	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT)
 	{
+		int i;
+
 		if(cur_salt->version == 2007) {
-			unsigned char encryptionKey[256];
-			GeneratePasswordHashUsingSHA1(saved_key[index], saved_len[index], encryptionKey);
-			ms_office_common_PasswordVerifier(cur_salt, encryptionKey, crypt_key[index]);
+			unsigned char encryptionKey[MAX_KEYS_PER_CRYPT][256];
+			GeneratePasswordHashUsingSHA1(index, encryptionKey);
+			for (i = 0; i < MAX_KEYS_PER_CRYPT; i++)
+				ms_office_common_PasswordVerifier(cur_salt, encryptionKey[i], crypt_key[index + i]);
 		}
 		else if (cur_salt->version == 2010) {
-			unsigned char verifierKeys[64], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
+			unsigned char verifierKeys[MAX_KEYS_PER_CRYPT][64], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
 			unsigned char hash[20];
 			SHA_CTX ctx;
-			GenerateAgileEncryptionKey(saved_key[index], saved_len[index], cur_salt->keySize >> 3, verifierKeys);
-			ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, verifierKeys, cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
-			ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, &verifierKeys[32], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
-			SHA1_Init(&ctx);
-			SHA1_Update(&ctx, decryptedVerifierHashInputBytes, 16);
-			SHA1_Final(hash, &ctx);
-			cracked[index] = !memcmp(hash, decryptedVerifierHashBytes, 20);
+			GenerateAgileEncryptionKey(index, cur_salt->keySize >> 3, verifierKeys);
+			for (i = 0; i < MAX_KEYS_PER_CRYPT; i++) {
+				ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, verifierKeys[i], cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
+				ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, &verifierKeys[i][32], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
+				SHA1_Init(&ctx);
+				SHA1_Update(&ctx, decryptedVerifierHashInputBytes, 16);
+				SHA1_Final(hash, &ctx);
+				cracked[index + i] = !memcmp(hash, decryptedVerifierHashBytes, 20);
+			}
 		}
 		else if (cur_salt->version == 2013) {
-			unsigned char verifierKeys[128], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
+			unsigned char verifierKeys[MAX_KEYS_PER_CRYPT][128], decryptedVerifierHashInputBytes[16], decryptedVerifierHashBytes[32];
 			unsigned char hash[64];
 			SHA512_CTX ctx;
-			GenerateAgileEncryptionKey512(saved_key[index], saved_len[index], verifierKeys);
-			ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, verifierKeys, cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
-			ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, &verifierKeys[64], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
-			SHA512_Init(&ctx);
-			SHA512_Update(&ctx, decryptedVerifierHashInputBytes, 16);
-			SHA512_Final(hash, &ctx);
-			cracked[index] = !memcmp(hash, decryptedVerifierHashBytes, 20);
+			GenerateAgileEncryptionKey512(index, verifierKeys);
+			for (i = 0; i < MAX_KEYS_PER_CRYPT; i++) {
+				ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, verifierKeys[i], cur_salt->encryptedVerifier, decryptedVerifierHashInputBytes, 16);
+				ms_office_common_DecryptUsingSymmetricKeyAlgorithm(cur_salt, &verifierKeys[i][64], cur_salt->encryptedVerifierHash, decryptedVerifierHashBytes, 32);
+				SHA512_Init(&ctx);
+				SHA512_Update(&ctx, decryptedVerifierHashInputBytes, 16);
+				SHA512_Final(hash, &ctx);
+				cracked[index + i] = !memcmp(hash, decryptedVerifierHashBytes, 20);
+			}
 		}
 	}
 	return count;
@@ -114,6 +114,8 @@ static struct opt_entry opt_list[] = {
 		FLG_PRINCE_CHK, 0},
 	{"prince-mmap", FLG_PRINCE_MMAP, 0,
 		FLG_PRINCE_CHK, FLG_PRINCE_CASE_PERMUTE},
+	{"prince-cache", FLG_ZERO, 0, FLG_PRINCE_CHK,
+		0, OPT_FMT_STR_ALLOC, &prince_cache_str},
 #endif
 	/* -enc is an alias for -input-enc for legacy reasons */
 	{"encoding", FLG_INPUT_ENC, FLG_INPUT_ENC,
@@ -391,7 +393,8 @@ void opt_print_hidden_usage(void)
 	printf(", omp");
 #endif
 	printf("\n");
-	puts("--subformat=FORMAT        pick a benchmark format for --format=crypt");
+	puts("--subformat=FORMAT        pick a benchmark format for --format=crypt, or a");
+	puts("                          dynamic format to compare --format=dynamic_N with");
 	puts("--mkpc=N                  request a lower max. keys per crypt");
 	puts("--min-length=N            request a minimum candidate length");
 	puts("--max-length=N            request a maximum candidate length");
@@ -440,6 +443,8 @@ void opt_print_hidden_usage(void)
 	puts("--prince-wl-max=N         load only N words from input wordlist");
 	puts("--prince-case-permute     permute case of first letter");
 	puts("--prince-mmap             memory-map infile (not available when permuting case)");
+	puts("--prince-cache=FILE       load processed elements and chains from FILE,");
+	puts("                          (re)building it if missing or stale");
 	puts("--prince-keyspace         just show total keyspace that would be produced");
 	puts("                          (disregarding skip and limit)");
 #endif
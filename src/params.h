@@ -184,12 +184,18 @@
 #define PASSWORD_HASH_SIZES		7
 
 /*
- * Which hash table size (out of those listed below) the loader should use for
- * its own purposes.  This does not affect password cracking speed after the
- * loading is complete.
+ * Which hash table size (out of those listed below) the loader should start
+ * with for its own purposes.  The table grows as needed.  This does not affect
+ * password cracking speed after the loading is complete.
  */
 #define PASSWORD_HASH_SIZE_FOR_LDR	4
 
+/*
+ * Initial number of binaries in the array the loader keeps them in when
+ * loading an unsalted format with a compact database.  It's doubled as needed.
+ */
+#define BINARY_ARRAY_SIZE		0x1000
+
 /*
  * Hash table sizes.  These may also be hardcoded into the hash functions.
  */
@@ -232,7 +238,8 @@ extern int password_hash_thresholds[PASSWORD_HASH_SIZES];
 #define PASSWORD_HASH_SHR		2
 
 /*
- * Cracked password hash size, used while loading.
+ * Initial cracked password hash size, used while loading.  The table doubles
+ * whenever it holds as many entries as it has buckets.
  */
 #define CRACKED_HASH_LOG		16
 #define CRACKED_HASH_SIZE		(1 << CRACKED_HASH_LOG)
@@ -252,6 +259,14 @@ extern int password_hash_thresholds[PASSWORD_HASH_SIZES];
  */
 #define SINGLE_HASH_MIN			8
 
+/*
+ * Size of the full (max_keys_per_crypt) key buffers in "single crack" mode,
+ * in megabytes.  If there are too many salts for all of them to get one, the
+ * salts are processed a window of this size at a time.  This should fit in
+ * the CPU cache.
+ */
+#define SINGLE_MAX_BUFFER_SIZE		4
+
 /*
  * Shadow file entry hash table size, used by unshadow.
  */
@@ -271,9 +286,11 @@ extern int password_hash_thresholds[PASSWORD_HASH_SIZES];
 #define LDR_WORDS_MAX			60
 
 /*
- * Maximum number of partial hash collisions in a db->password_hash[] bucket.
- * If this limit is hit, we print a warning and disable detection of duplicate
- * hashes (since it could be too slow).
+ * Maximum number of hash collisions in a db->password_hash[] bucket.  Since
+ * the table is keyed on the full binary and grows with the number of loaded
+ * hashes, this is only hit with many identical binaries that have different
+ * ciphertexts.  If it is, we print a warning and disable detection of
+ * duplicate hashes (since it could be too slow).
  */
 #define LDR_HASH_COLLISIONS_MAX		1000
 
@@ -360,6 +377,20 @@ extern int password_hash_thresholds[PASSWORD_HASH_SIZES];
 /* Default maximum size of wordlist memory buffer. */
 #define WORDLIST_BUFFER_DEFAULT		5000000
 
+/*
+ * Largest wordlist, in megabytes, that --dupe-suppression loads into memory.
+ * Bigger ones are checked while streaming, using a fingerprint table of at
+ * most this size.
+ */
+#define WORDLIST_DUPE_MEMORY		1024
+
+/*
+ * Size in megabytes of the filter that drops candidates the wordlist rules
+ * have recently produced already, or 0 to disable it.  Worth it for slow
+ * hashes, where a suppressed candidate saves far more than it costs.
+ */
+#define RULES_DUPE_FILTER_SIZE		0
+
 /* Number of custom Mask placeholders */
 #define MAX_NUM_CUST_PLHDR 9
 
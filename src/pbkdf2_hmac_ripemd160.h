@@ -17,7 +17,9 @@
 #define JOHN_PBKDF2_HMAC_RIPEMD160_H
 
 #include <string.h>
+#include "arch.h"
 #include "sph_ripemd.h"
+#include "sse-intrinsics.h"
 
 #if (AC_BUILT && HAVE_RIPEMD160) && 0
 // actually, built in sph_ripemd160 may be faster than oSSL build :(
@@ -117,4 +119,93 @@ static void pbkdf2_ripemd160(const unsigned char *K, int KL, const unsigned char
 	}
 }
 
+
+#ifdef MMX_COEF_RIPEMD160
+
+#define SSE_GROUP_SZ_RIPEMD160 MMX_COEF_RIPEMD160
+
+/*
+ * Same scheme as pbkdf2_sha1_sse(): the ipad/opad half states are loaded
+ * once, and each iteration is then 2 SSERIPEMD160body calls over all the
+ * lanes.  RIPEMD-160 is little endian, so there is no byte swapping.
+ */
+static void pbkdf2_ripemd160_sse(const unsigned char *K[SSE_GROUP_SZ_RIPEMD160], int KL[SSE_GROUP_SZ_RIPEMD160], const unsigned char *S, int SL, int R, unsigned char *out[SSE_GROUP_SZ_RIPEMD160], int outlen, int skip_bytes)
+{
+	unsigned char tmp_hash[RIPEMD160_DIGEST_LENGTH];
+	ARCH_WORD_32 *i1, *i2, *o1, *ptmp;
+	int i,j;
+	ARCH_WORD_32 dgst[SSE_GROUP_SZ_RIPEMD160][RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)];
+	int loops, accum=0;
+	unsigned char loop;
+	sph_ripemd160_context ipad[SSE_GROUP_SZ_RIPEMD160], opad[SSE_GROUP_SZ_RIPEMD160], ctx;
+
+	JTR_ALIGN(16) ARCH_WORD_32 sse_hash1[RIPEMD160_BUF_SIZ*SSE_GROUP_SZ_RIPEMD160];
+	JTR_ALIGN(16) ARCH_WORD_32 sse_crypt1[RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)*SSE_GROUP_SZ_RIPEMD160];
+	JTR_ALIGN(16) ARCH_WORD_32 sse_crypt2[RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)*SSE_GROUP_SZ_RIPEMD160];
+	i1 = sse_crypt1;
+	i2 = sse_crypt2;
+	o1 = sse_hash1;
+
+	// set the constant part of the data buffer ONE time.  The 0x80 byte goes right after
+	// the 20 byte digest, and the bit count (64+20 bytes) in the LE length slot.
+	for (i = 0; i < MMX_COEF_RIPEMD160; ++i) {
+		o1[(RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32))*MMX_COEF_RIPEMD160 + i] = 0x80;
+		for (j = RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32)+1; j < 14; ++j)
+			o1[j*MMX_COEF_RIPEMD160 + i] = 0;
+		o1[14*MMX_COEF_RIPEMD160 + i] = ((64+RIPEMD160_DIGEST_LENGTH)<<3);
+		o1[15*MMX_COEF_RIPEMD160 + i] = 0;
+	}
+
+	for (j = 0; j < SSE_GROUP_SZ_RIPEMD160; ++j) {
+		_pbkdf2_ripemd160_load_hmac(K[j], KL[j], &ipad[j], &opad[j]);
+		for (i = 0; i < RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32); ++i) {
+			i1[i*MMX_COEF_RIPEMD160 + j] = ipad[j].val[i];
+			i2[i*MMX_COEF_RIPEMD160 + j] = opad[j].val[i];
+		}
+	}
+
+	loops = (skip_bytes + outlen + (RIPEMD160_DIGEST_LENGTH-1)) / RIPEMD160_DIGEST_LENGTH;
+	loop = skip_bytes / RIPEMD160_DIGEST_LENGTH + 1;
+	while (loop <= loops) {
+		int k;
+		for (j = 0; j < SSE_GROUP_SZ_RIPEMD160; ++j) {
+			memcpy(&ctx, &ipad[j], sizeof(ctx));
+			sph_ripemd160(&ctx, S, SL);
+			sph_ripemd160(&ctx, "\x0\x0\x0", 3);
+			sph_ripemd160(&ctx, &loop, 1);
+			sph_ripemd160_close(&ctx, tmp_hash);
+
+			memcpy(&ctx, &opad[j], sizeof(ctx));
+			sph_ripemd160(&ctx, tmp_hash, RIPEMD160_DIGEST_LENGTH);
+			sph_ripemd160_close(&ctx, tmp_hash);
+
+			// first iteration done, now move it into the interleaved buffer
+			ptmp = &o1[j];
+			memcpy(dgst[j], tmp_hash, RIPEMD160_DIGEST_LENGTH);
+			for (i = 0; i < RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32); ++i)
+				ptmp[i*MMX_COEF_RIPEMD160] = dgst[j][i];
+		}
+
+		for (i = 1; i < R; i++) {
+			SSERIPEMD160body((__m128i*)o1, o1, i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+			SSERIPEMD160body((__m128i*)o1, o1, i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
+			for (k = 0; k < SSE_GROUP_SZ_RIPEMD160; k++) {
+				ptmp = &o1[k];
+				for (j = 0; j < RIPEMD160_DIGEST_LENGTH/sizeof(ARCH_WORD_32); j++)
+					dgst[k][j] ^= ptmp[j*MMX_COEF_RIPEMD160];
+			}
+		}
+
+		for (i = skip_bytes%RIPEMD160_DIGEST_LENGTH; i < RIPEMD160_DIGEST_LENGTH && accum < outlen; ++i) {
+			for (j = 0; j < SSE_GROUP_SZ_RIPEMD160; ++j)
+				out[j][accum] = ((unsigned char*)(dgst[j]))[i];
+			++accum;
+		}
+		++loop;
+		skip_bytes = 0;
+	}
+}
+
+#endif
+
 #endif
@@ -50,6 +50,10 @@ typedef struct zip_salt_t {
 								// (under 16k), then it simply read into H[x].h at init() time.
 								// and cmp_exact does not need fname to be used.
 	u32 offset;					// this is the offset to zip data (if we have to read from the file).
+	u8 *blob;					// if non-NULL, the zip blob (at offset) in the archive's mmap(), which all
+								// salts from that archive share.  cmp_exact then reads from memory instead
+								// of re-opening fname.  The mapping is read-only and shared, so --fork
+								// children do not duplicate it.
 	u32 full_zip_idx;			// the index (0, 1, 2) which contains the 'full zip' data.
 	// start of the dyna zip 'compared' data.
 	u32 cnt;					// number of hashes
@@ -22,6 +22,24 @@ john_register_one(&fmt_pkzip);
 
 #include <string.h>
 
+#include "arch.h"
+#if AC_BUILT
+#include "autoconfig.h"
+#endif
+#if _MSC_VER || __MINGW32__ || __MINGW64__ || __CYGWIN__ || HAVE_WINDOWS_H
+#include "win32_memmap.h"
+#ifndef __CYGWIN__
+#include "mmap-windows.c"
+#elif defined HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#elif defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
+#if HAVE_MMAP
+#include <sys/stat.h>
+#endif
+
 #include "common.h"
 #include "arch.h"
 #include "misc.h"
@@ -152,7 +170,11 @@ static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static u32  *K12;
 static PKZ_SALT *salt;
 static u8 *chk;
+static int *cand;
 static int dirty=1;
+#if (ZIP_DEBUG==2)
+static int CNT, FAILED, FAILED2;
+#endif
 #if USE_PKZIP_MAGIC
 static ZIP_SIGS SIGS[256];
 #endif
@@ -370,6 +392,8 @@ static void init(struct fmt_main *self)
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	chk = mem_calloc_tiny(sizeof(*chk) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	cand = mem_calloc_tiny(sizeof(*cand) *
+			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 
 	/*
 	 * Precompute the multiply mangling, within several parts of the hash. There is a pattern,
@@ -488,6 +512,68 @@ static void set_salt(void *_salt) {
 	salt->H[2].h = &salt->zip_data[2+salt->H[0].datlen+salt->H[1].datlen];
 }
 
+#if HAVE_MMAP
+/*
+ * Archives mapped by get_salt().  Each archive is mapped once, and all salts
+ * from it (including duplicates the loader later drops) point into that one
+ * mapping.  Archives larger than PKZ_MMAP_MAX are not mapped, and cmp_exact
+ * reads them through the file instead.
+ */
+#define PKZ_MMAP_MAX			((size_t)(ARCH_BITS >= 64 ? 1024 : 128) << 20)
+
+static struct pkz_map {
+	struct pkz_map *next;
+	u8 *base;					// NULL if the archive is too big or mmap() failed
+	size_t len;
+	char fname[1];
+} *pkz_maps;
+
+static u8 *pkz_map_blob(const char *fname, FILE *fp, u32 offset, u32 len)
+{
+	struct pkz_map *m;
+	struct stat st;
+
+	for (m = pkz_maps; m; m = m->next)
+		if (!strcmp(m->fname, fname))
+			break;
+
+	if (!m) {
+		m = mem_alloc(sizeof(*m) + strlen(fname));
+		strcpy(m->fname, fname);
+		m->base = NULL;
+		m->len = 0;
+		if (!fstat(fileno(fp), &st) && st.st_size > 0 &&
+		    (unsigned long long)st.st_size <= PKZ_MMAP_MAX) {
+			m->len = st.st_size;
+			m->base = mmap(NULL, m->len, PROT_READ, MAP_SHARED,
+			               fileno(fp), 0);
+			if (m->base == MAP_FAILED)
+				m->base = NULL;
+		}
+		m->next = pkz_maps;
+		pkz_maps = m;
+	}
+
+	if (!m->base || (size_t)offset + len > m->len)
+		return NULL;
+	return m->base + offset;
+}
+#endif
+
+static void done(void)
+{
+#if HAVE_MMAP
+	while (pkz_maps) {
+		struct pkz_map *m = pkz_maps;
+
+		pkz_maps = m->next;
+		if (m->base)
+			munmap(m->base, m->len);
+		MEM_FREE(m);
+	}
+#endif
+}
+
 static void *get_salt(char *ciphertext)
 {
 	/* NOTE, almost NO error checking at all in this function.  Proper error checking done in valid() */
@@ -597,6 +683,12 @@ static void *get_salt(char *ciphertext)
 					/* read the zip data only when it 'needs' it.                                */
 					strnzcpy(salt->fname, (const char *)cp, sizeof(salt->fname));
 					salt->offset = offset+offex;
+#if HAVE_MMAP
+					/* Point into the archive's mapping, so that cmp_exact does not have to */
+					/* re-open and seek the file for every candidate.  If the archive is too */
+					/* big or can't be mapped, blob stays NULL and we fall back to file reads. */
+					salt->blob = pkz_map_blob(salt->fname, fp, salt->offset, salt->compLen);
+#endif
 					ex_len[i] = 384;
 					H[i] = mem_alloc(384);
 					if (fread(H[i], 1, 384, fp) != 384) {
@@ -718,11 +810,13 @@ static int get_next_decrypted_block(u8 *in, int sizeof_n, FILE *fp, u32 *inp_use
 	if (*inp_used + new_bytes > salt->compLen)
 		/* this is the last block.  Only load the bytes that are left */
 		new_bytes = salt->compLen - *inp_used;
+	/* read the data (from the mapped blob, if we have one) */
+	if (salt->blob)
+		memcpy(in, &salt->blob[*inp_used], new_bytes);
+	else if (fread(in, 1, new_bytes, fp) != new_bytes)
+		return 0;
 	/* return the correct 'offset', so we can track when the file buffer has been fully read */
 	*inp_used += new_bytes;
-	/* read the data */
-	if (fread(in, 1, new_bytes, fp) != new_bytes)
-		return 0;
 
 	/* decrypt the data bytes (in place, in same buffer). Easy to do, only requires 1 temp character variable.  */
 	for (k = 0; k < new_bytes; ++k) {
@@ -762,25 +856,29 @@ static int cmp_exact_loadfile(int index) {
 	u32 crc = 0xFFFFFFFF;
 
 	/* Open the zip file, and 'seek' to the proper offset of the binary zip blob */
-	fp = fopen(salt->fname, "rb");
-	if (!fp) {
-		fprintf (stderr, "\nERROR, the zip file: %s has been removed.\nWe are a possible password has been found, but FULL validation can not be done!\n", salt->fname);
-		return 1;
-	}
-	if (fseek(fp, salt->offset, SEEK_SET)) {
-		fprintf (stderr, "\nERROR, the zip file: %s fseek() failed.\nWe are a possible password has been found, but FULL validation can not be done!\n", salt->fname);
-		fclose(fp);
-		return 1;
+	/* (not needed if get_salt() was able to mmap the blob). */
+	fp = NULL;
+	if (!salt->blob) {
+		fp = fopen(salt->fname, "rb");
+		if (!fp) {
+			fprintf (stderr, "\nERROR, the zip file: %s has been removed.\nWe are a possible password has been found, but FULL validation can not be done!\n", salt->fname);
+			return 1;
+		}
+		if (fseek(fp, salt->offset, SEEK_SET)) {
+			fprintf (stderr, "\nERROR, the zip file: %s fseek() failed.\nWe are a possible password has been found, but FULL validation can not be done!\n", salt->fname);
+			fclose(fp);
+			return 1;
+		}
+		if (fread(in, 1, 12, fp) != 12) {
+			fprintf (stderr, "\nERROR, the zip file: %s fread() failed.\nWe are a possible password has been found, but FULL validation can not be done!\n", salt->fname);
+			fclose(fp);
+			return 1;
+		}
 	}
 
 	/* 'seed' the decryption with the IV. We do NOT use these bytes, they simply seed us. */
 	key0.u = K12[index*3], key1.u = K12[index*3+1], key2.u = K12[index*3+2];
 	k=12;
-	if (fread(in, 1, 12, fp) != 12) {
-		fprintf (stderr, "\nERROR, the zip file: %s fread() failed.\nWe are a possible password has been found, but FULL validation can not be done!\n", salt->fname);
-		fclose(fp);
-		return 1;
-	}
 
 	b = salt->H[salt->full_zip_idx].h;
 	do {
@@ -806,7 +904,8 @@ static int cmp_exact_loadfile(int index) {
 				crc = pkzip_crc32(crc,in[k]);
 			avail_in = get_next_decrypted_block(in, CHUNK, fp, &inp_used, &key0, &key1, &key2);
 		}
-		fclose(fp);
+		if (fp)
+			fclose(fp);
 		return ~crc == salt->crc32;
 	}
 
@@ -823,7 +922,7 @@ static int cmp_exact_loadfile(int index) {
     /* decompress until deflate stream ends or end of file */
     do {
         strm.avail_in = get_next_decrypted_block(in, CHUNK, fp, &inp_used, &key0, &key1, &key2);
-        if (ferror(fp)) {
+        if (fp && ferror(fp)) {
             inflateEnd(&strm);
 			fclose(fp);
 			fprintf (stderr, "\nERROR, the zip file: %s fread() failed.\nWe are a possible password has been found, but FULL validation can not be done!\n", salt->fname);
@@ -843,7 +942,8 @@ static int cmp_exact_loadfile(int index) {
 			    case Z_DATA_ERROR:
 				case Z_MEM_ERROR:
 					inflateEnd(&strm);
-					fclose(fp);
+					if (fp)
+						fclose(fp);
 					return 0;
             }
             have = CHUNK - strm.avail_out;
@@ -858,7 +958,8 @@ static int cmp_exact_loadfile(int index) {
 
     /* clean up and return */
     inflateEnd(&strm);
-	fclose(fp);
+	if (fp)
+		fclose(fp);
 	return ret == Z_STREAM_END && inp_used == salt->compLen && decomp_len == salt->deCompLen && salt->crc32 == ~crc;
 }
 
@@ -1302,249 +1403,221 @@ MAYBE_INLINE static int check_inflate_CODE1(u8 *next, int left) {
 #endif
 
 /*
- * Crypt_all simply performs the checksum .zip validatation of the data. It performs
- * this for ALL hashes provided. If any of them fail to match, then crypt all puts the
- * complement of the 'proper' checksum of the first hash into the output. These 2 bytes
- * are checked against the binary for this salt/password combination.  Thus, if any
- * checksum fails, it will never match binary.  However, if ALL of the checksums match
- * we then put the checksum bytes from the first hash, into our output data. Then, when
- * the binary check (cmp_all, cmp_one) is performed, it WILL match.  NOTE, this does
- * not mean we have found the password.  Just that all hashes quick check checksums
- * for this password 'work'.
+ * Password verification is done in 2 stages.  check_checksums() is the cheap first
+ * stage: it decrypts only the 12 byte encryption header of every hash and compares
+ * the checksum byte(s).  That is the same small fixed amount of work for every
+ * candidate, and it drops all but about 1/256 (or 1/65536 for 2 byte checksums) of
+ * them for each hash.  check_password() is the second stage, which does the inflate,
+ * magic signature and (for small blobs) partial inflate checks.  It is only run on
+ * the short, compacted list of candidates which survived the first stage, so it is
+ * spread over the threads evenly, instead of landing on whichever thread happened to
+ * own the few survivors.
  */
-static int crypt_all(int *pcount, struct db_salt *_salt)
+static int check_checksums(int idx)
 {
-	int _count = *pcount;
-	int idx;
-#if (ZIP_DEBUG==2)
-	static int CNT, FAILED, FAILED2;
-	++CNT;
-#endif
+	u32 i;
 
-	// pkzip kinda sucks a little for multi-threading, since there is different amount of work to be
-	// done, depenging upon the password.  Thus, we pack in OMP_MOD passwords into each thread, and
-	// hopefully some of the differnces will even themselves out in the end.  If we have 2 threads
-	// then thread 1 gets 0 to 127 password, and thread 2 gets 128-256.  Once they 'get' their data,
-	// there should be no mutexing of the runtime data, thus the threads should run fast.
-	// Also, since we have 'multiple' files in a .zip file (and multiple checksums), we bail as at the
-	// first time we fail to match checksum.  So, there may be some threads which check more checksums.
-	// Again, hopefully globbing many tests into a threads working set will flatten out these differences.
-#ifdef _OPENMP
-#pragma omp parallel for private(idx)
-#endif
-	for (idx = 0; idx < _count; ++idx) {
-		int cur_hash_count = salt->cnt;
-		int cur_hash_idx = -1;
+	for (i = 0; i < salt->cnt; ++i) {
 		MY_WORD key0, key1, key2;
+		const u8 *b = salt->H[i].h;
+		int k = 11;
 		u8 C;
-		const u8 *b;
-		u8 curDecryBuf[256];
+
+		key0.u = K12[idx*3], key1.u = K12[idx*3+1], key2.u = K12[idx*3+2];
+		do
+		{
+			C = PKZ_MULT(*b++,key2);
+			key0.u = pkzip_crc32 (key0.u, C);
+			key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+			key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+		}
+		while(--k);
+
+		if (salt->chk_bytes == 2 && C != (salt->H[i].c&0xFF) && C != (salt->H[i].c2&0xFF))
+			return 0;
+		C = PKZ_MULT(*b,key2);
+		if (C != (salt->H[i].c>>8) && C != (salt->H[i].c2>>8))
+			return 0;
+	}
+	return 1;
+}
+
+static int check_password(int idx)
+{
+	int cur_hash_count = salt->cnt;
+	int cur_hash_idx = -1;
+	MY_WORD key0, key1, key2;
+	u8 C;
+	const u8 *b;
+	u8 curDecryBuf[256];
 #if USE_PKZIP_MAGIC
-		u8 curInfBuf[128];
+	u8 curInfBuf[128];
 #endif
-		int k, SigChecked;
-		u16 e, e2, v1, v2;
-		z_stream strm;
-		int ret;
+	int k, SigChecked;
+	u16 e, e2, v1, v2;
+	z_stream strm;
+	int ret;
 
-		/* use the pwkey for each hash.  We mangle on the 12 bytes of IV to what  was computed in the pwkey load. */
+	do
+	{
+		// the password key setup was done (once per key load) by crypt_all, and saved in K12[]
+		key0.u = K12[idx*3], key1.u = K12[idx*3+1], key2.u = K12[idx*3+2];
 
-		if (dirty) {
-			u8 *p = (u8*)saved_key[idx];
-
-			/* load the 'pwkey' one time, put it into the K12 array */
-			key0.u = 0x12345678UL; key1.u = 0x23456789UL; key2.u = 0x34567890UL;
-			do {
-				key0.u = pkzip_crc32 (key0.u, *p++);
-				key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-				key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
-			} while (*p);
-			K12[idx*3] = key0.u, K12[idx*3+1] = key1.u, K12[idx*3+2] = key2.u;
-			goto SkipKeyLoadInit;
-		}
+		b = salt->H[++cur_hash_idx].h;
+		k=11;
+		e = salt->H[cur_hash_idx].c;
+		e2 = salt->H[cur_hash_idx].c2;
 
 		do
 		{
-			// 2nd, and later times through the loop, AND if keys are not dirty (i.e. multiple salts
-			// for the same key load), we do NOT perform the key compute, but instead load the pre-computed
-			// key data from the array.
-			key0.u = K12[idx*3], key1.u = K12[idx*3+1], key2.u = K12[idx*3+2];
-
-SkipKeyLoadInit:;
-			b = salt->H[++cur_hash_idx].h;
-			k=11;
-			e = salt->H[cur_hash_idx].c;
-			e2 = salt->H[cur_hash_idx].c2;
-
-			do
-			{
-				C = PKZ_MULT(*b++,key2);
-				key0.u = pkzip_crc32 (key0.u, C);
-				key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-				key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
-			}
-			while(--k);
+			C = PKZ_MULT(*b++,key2);
+			key0.u = pkzip_crc32 (key0.u, C);
+			key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+			key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+		}
+		while(--k);
 
-			/* if the hash is a 2 byte checksum type, then check that value first */
-			/* There is no reason to continue if this byte does not check out.  */
-			if (salt->chk_bytes == 2 && C != (e&0xFF) && C != (e2&0xFF))
-				goto Failed_Bailout;
+		/* if the hash is a 2 byte checksum type, then check that value first */
+		/* There is no reason to continue if this byte does not check out.  */
+		if (salt->chk_bytes == 2 && C != (e&0xFF) && C != (e2&0xFF))
+			return 0;
 
-			C = PKZ_MULT(*b++,key2);
+		C = PKZ_MULT(*b++,key2);
 #if 1
-			// https://github.com/magnumripper/JohnTheRipper/issues/467
-			// Fixed, JimF.  Added checksum test for crc32 and timestamp.
-			if (C != (e>>8) && C != (e2>>8))
-				goto Failed_Bailout;
+		// https://github.com/magnumripper/JohnTheRipper/issues/467
+		// Fixed, JimF.  Added checksum test for crc32 and timestamp.
+		if (C != (e>>8) && C != (e2>>8))
+			return 0;
 #endif
 
-			// Now, update the key data (with that last byte.
-			key0.u = pkzip_crc32 (key0.u, C);
-			key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-			key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+		// Now, update the key data (with that last byte.
+		key0.u = pkzip_crc32 (key0.u, C);
+		key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+		key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
 
-			// Ok, we now have validated this checksum.  We need to 'do some' extra pkzip validation work.
-			// What we do here, is to decrypt a little data (possibly only 1 byte), and perform a single
-			// 'inflate' check (if type is 8).  If type is 0 (stored), and we have a signature check, then
-			// we do that here.  Also, if the inflate code is a 0 (stored block), and we do sig check, then
-			// we can do that WITHOUT having to call inflate.  however, if there IS a sig check, we will have
-			// to call inflate on 'some' data, to get a few bytes (or error code). Also, if this is a type
-			// 2 or 3, then we do the FULL inflate, CRC check here.
-			e = 0;
+		// Ok, we now have validated this checksum.  We need to 'do some' extra pkzip validation work.
+		// What we do here, is to decrypt a little data (possibly only 1 byte), and perform a single
+		// 'inflate' check (if type is 8).  If type is 0 (stored), and we have a signature check, then
+		// we do that here.  Also, if the inflate code is a 0 (stored block), and we do sig check, then
+		// we can do that WITHOUT having to call inflate.  however, if there IS a sig check, we will have
+		// to call inflate on 'some' data, to get a few bytes (or error code). Also, if this is a type
+		// 2 or 3, then we do the FULL inflate, CRC check here.
+		e = 0;
 
-			// First, we want to get the inflate CODE byte (the first one).
+		// First, we want to get the inflate CODE byte (the first one).
 
-			C = PKZ_MULT(*b++,key2);
-			SigChecked = 0;
-			if ( salt->H[cur_hash_idx].compType == 0) {
-				// handle a stored file.
-				// We can ONLY deal with these IF we are handling 'magic' testing.
+		C = PKZ_MULT(*b++,key2);
+		SigChecked = 0;
+		if ( salt->H[cur_hash_idx].compType == 0) {
+			// handle a stored file.
+			// We can ONLY deal with these IF we are handling 'magic' testing.
 
 #if USE_PKZIP_MAGIC
-				// Ok, if we have a signature, check it here, WITHOUT having to call zLib's inflate.
-				if (salt->H[cur_hash_idx].pSig->max_len) {
-					int len = salt->H[cur_hash_idx].pSig->max_len;
-					if (len > salt->H[cur_hash_idx].datlen-12)
-						len = salt->H[cur_hash_idx].datlen-12;
-					SigChecked = 1;
-					curDecryBuf[0] = C;
-					for (; e < len;) {
-						key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
-						key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-						key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
-						curDecryBuf[++e] = PKZ_MULT(*b++,key2);
-					}
+			// Ok, if we have a signature, check it here, WITHOUT having to call zLib's inflate.
+			if (salt->H[cur_hash_idx].pSig->max_len) {
+				int len = salt->H[cur_hash_idx].pSig->max_len;
+				if (len > salt->H[cur_hash_idx].datlen-12)
+					len = salt->H[cur_hash_idx].datlen-12;
+				SigChecked = 1;
+				curDecryBuf[0] = C;
+				for (; e < len;) {
+					key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
+					key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+					key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+					curDecryBuf[++e] = PKZ_MULT(*b++,key2);
+				}
 
-					if (salt->H[cur_hash_idx].magic == 255) {
-						if (!validate_ascii(&curDecryBuf[5], len-5))
-							goto Failed_Bailout;
-					} else {
-						if (!CheckSigs(curDecryBuf, len, salt->H[cur_hash_idx].pSig))
-							goto Failed_Bailout;
-					}
+				if (salt->H[cur_hash_idx].magic == 255) {
+					if (!validate_ascii(&curDecryBuf[5], len-5))
+						return 0;
+				} else {
+					if (!CheckSigs(curDecryBuf, len, salt->H[cur_hash_idx].pSig))
+						return 0;
 				}
-#endif
-				continue;
 			}
+#endif
+			continue;
+		}
 #if 1
-			// https://github.com/magnumripper/JohnTheRipper/issues/467
-			// Ok, if this is a code 3, we are done.
-			// Code moved to after the check for stored type.  (FIXED)  This check was INVALID for a stored type file.
-			if ( (C & 6) == 6)
-				goto Failed_Bailout;
+		// https://github.com/magnumripper/JohnTheRipper/issues/467
+		// Ok, if this is a code 3, we are done.
+		// Code moved to after the check for stored type.  (FIXED)  This check was INVALID for a stored type file.
+		if ( (C & 6) == 6)
+			return 0;
 #endif
-			if ( (C & 6) == 0) {
-				// Check that checksum2 is 0 or 1.  If not, I 'think' we can be done
-				if (C > 1)
-					goto Failed_Bailout;
-				// now get 4 bytes.  This is the length.  It is made up of 2 16 bit values.
-				// these 2 values are checksumed, so it is easy to tell if the data is WRONG.
-				// correct data is u16_1 == (u16_2^0xFFFF)
-				curDecryBuf[0] = C;
-				for (e = 0; e <= 4; ) {
+		if ( (C & 6) == 0) {
+			// Check that checksum2 is 0 or 1.  If not, I 'think' we can be done
+			if (C > 1)
+				return 0;
+			// now get 4 bytes.  This is the length.  It is made up of 2 16 bit values.
+			// these 2 values are checksumed, so it is easy to tell if the data is WRONG.
+			// correct data is u16_1 == (u16_2^0xFFFF)
+			curDecryBuf[0] = C;
+			for (e = 0; e <= 4; ) {
+				key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
+				key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+				key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+				curDecryBuf[++e] = PKZ_MULT(*b++,key2);
+			}
+			v1 = curDecryBuf[1] | (((u16)curDecryBuf[2])<<8);
+			v2 = curDecryBuf[3] | (((u16)curDecryBuf[4])<<8);
+			if (v1 != (v2^0xFFFF))
+				return 0;
+#if USE_PKZIP_MAGIC
+			// Ok, if we have a signature, check it here, WITHOUT having to call zLib's inflate.
+			if (salt->H[cur_hash_idx].pSig->max_len) {
+				int len = salt->H[cur_hash_idx].pSig->max_len + 5;
+				if (len > salt->H[cur_hash_idx].datlen-12)
+					len = salt->H[cur_hash_idx].datlen-12;
+				SigChecked = 1;
+				for (; e < len;) {
 					key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
 					key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
 					key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
 					curDecryBuf[++e] = PKZ_MULT(*b++,key2);
 				}
-				v1 = curDecryBuf[1] | (((u16)curDecryBuf[2])<<8);
-				v2 = curDecryBuf[3] | (((u16)curDecryBuf[4])<<8);
-				if (v1 != (v2^0xFFFF))
-					goto Failed_Bailout;
-#if USE_PKZIP_MAGIC
-				// Ok, if we have a signature, check it here, WITHOUT having to call zLib's inflate.
-				if (salt->H[cur_hash_idx].pSig->max_len) {
-					int len = salt->H[cur_hash_idx].pSig->max_len + 5;
-					if (len > salt->H[cur_hash_idx].datlen-12)
-						len = salt->H[cur_hash_idx].datlen-12;
-					SigChecked = 1;
-					for (; e < len;) {
-						key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
-						key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-						key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
-						curDecryBuf[++e] = PKZ_MULT(*b++,key2);
-					}
 
-					if (salt->H[cur_hash_idx].magic == 255) {
-						if (!validate_ascii(&curDecryBuf[5], len-5))
-							goto Failed_Bailout;
-					} else {
-						if (!CheckSigs(&curDecryBuf[5], len-5, salt->H[cur_hash_idx].pSig))
-							goto Failed_Bailout;
-					}
+				if (salt->H[cur_hash_idx].magic == 255) {
+					if (!validate_ascii(&curDecryBuf[5], len-5))
+						return 0;
+				} else {
+					if (!CheckSigs(&curDecryBuf[5], len-5, salt->H[cur_hash_idx].pSig))
+						return 0;
 				}
-#endif
 			}
-			else {
-				// Ok, now we have handled inflate code type 3 and inflate code 0 (50% of 'random' data)
-				// We now have the 2 'hard' ones left (fixed table, and variable table)
+#endif
+		}
+		else {
+			// Ok, now we have handled inflate code type 3 and inflate code 0 (50% of 'random' data)
+			// We now have the 2 'hard' ones left (fixed table, and variable table)
 
-				curDecryBuf[0] = C;
+			curDecryBuf[0] = C;
 
-				if ((C&6) == 4) { // inflate 'code' 2  (variable table)
+			if ((C&6) == 4) { // inflate 'code' 2  (variable table)
 #if (ZIP_DEBUG==2)
-					static unsigned count, found;
-					++count;
-#endif
-					// we need 4 bytes, + 2, + 4 at most.
-					for (; e < 10;) {
-						key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
-						key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-						key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
-						curDecryBuf[++e] = PKZ_MULT(*b++,key2);
-					}
-					if (!check_inflate_CODE2(curDecryBuf))
-						goto Failed_Bailout;
-#if (ZIP_DEBUG==2)
-					fprintf (stderr, "CODE2 Pass=%s  count = %u, found = %u\n", saved_key[idx], count, ++found);
+				static unsigned count, found;
+				++count;
 #endif
+				// we need 4 bytes, + 2, + 4 at most.
+				for (; e < 10;) {
+					key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
+					key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+					key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+					curDecryBuf[++e] = PKZ_MULT(*b++,key2);
 				}
-				else {
-					int til;
+				if (!check_inflate_CODE2(curDecryBuf))
+					return 0;
 #if (ZIP_DEBUG==2)
-					static unsigned count, found;
-					++count;
+				fprintf (stderr, "CODE2 Pass=%s  count = %u, found = %u\n", saved_key[idx], count, ++found);
 #endif
-					til = 36;
-					if (salt->H[cur_hash_idx].datlen-12 < til)
-						til = salt->H[cur_hash_idx].datlen-12;
-					for (; e < til;) {
-						key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
-						key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-						key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
-						curDecryBuf[++e] = PKZ_MULT(*b++,key2);
-					}
-					if (!check_inflate_CODE1(curDecryBuf, til))
-						goto Failed_Bailout;
+			}
+			else {
+				int til;
 #if (ZIP_DEBUG==2)
-					fprintf (stderr, "CODE1 Pass=%s  count = %u, found = %u\n", saved_key[idx], count, ++found);
+				static unsigned count, found;
+				++count;
 #endif
-				}
-			}
-#if USE_PKZIP_MAGIC
-			// Ok, now see if we need to check sigs, or do a FULL inflate/crc check.
-			if (!SigChecked && salt->H[cur_hash_idx].pSig->max_len) {
-				int til = 180;
+				til = 36;
 				if (salt->H[cur_hash_idx].datlen-12 < til)
 					til = salt->H[cur_hash_idx].datlen-12;
 				for (; e < til;) {
@@ -1553,95 +1626,157 @@ SkipKeyLoadInit:;
 					key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
 					curDecryBuf[++e] = PKZ_MULT(*b++,key2);
 				}
+				if (!check_inflate_CODE1(curDecryBuf, til))
+					return 0;
+#if (ZIP_DEBUG==2)
+				fprintf (stderr, "CODE1 Pass=%s  count = %u, found = %u\n", saved_key[idx], count, ++found);
+#endif
+			}
+		}
+#if USE_PKZIP_MAGIC
+		// Ok, now see if we need to check sigs, or do a FULL inflate/crc check.
+		if (!SigChecked && salt->H[cur_hash_idx].pSig->max_len) {
+			int til = 180;
+			if (salt->H[cur_hash_idx].datlen-12 < til)
+				til = salt->H[cur_hash_idx].datlen-12;
+			for (; e < til;) {
+				key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
+				key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+				key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+				curDecryBuf[++e] = PKZ_MULT(*b++,key2);
+			}
+			strm.zalloc = Z_NULL; strm.zfree = Z_NULL; strm.opaque = Z_NULL; strm.next_in = Z_NULL;
+			strm.avail_in = til;
+
+			ret = inflateInit2(&strm, -15); /* 'raw', since we do not have gzip header, or gzip crc. .ZIP files are 'raw' implode data. */
+			if (ret != Z_OK)
+			   perror("Error, initializing the libz inflateInit2() system\n");
+
+			strm.next_in = curDecryBuf;
+			strm.avail_out = sizeof(curInfBuf);
+			strm.next_out = curInfBuf;
+
+			ret = inflate(&strm, Z_SYNC_FLUSH);
+
+			inflateEnd(&strm);
+			if (ret != Z_OK) {
+				// we need to handle zips smaller than sizeof curInfBuf.  If we find a zip of this
+				// size, the return is Z_STREAM_END, BUT things are fine.
+				if (ret == Z_STREAM_END && salt->deCompLen == strm.total_out)
+					; // things are ok.
+				else
+				return 0;
+			}
+			if (!strm.total_out)
+				return 0;
+
+			ret = salt->H[cur_hash_idx].pSig->max_len;
+			if (salt->H[cur_hash_idx].magic == 255) {
+				if (!validate_ascii(curInfBuf, strm.total_out))
+					return 0;
+			} else {
+				if (strm.total_out < ret)
+					return 0;
+				if (!CheckSigs(curInfBuf, strm.total_out, salt->H[cur_hash_idx].pSig))
+					return 0;
+			}
+		}
+#endif
+
+		if (salt->H[cur_hash_idx].full_zip) {
+			u8 inflateBufTmp[1024];
+			if (salt->compLen > 240 && salt->H[cur_hash_idx].datlen >= 200) {
+				for (;e < 200;) {
+					key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
+					key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+					key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+					curDecryBuf[++e] = PKZ_MULT(*b++,key2);
+				}
 				strm.zalloc = Z_NULL; strm.zfree = Z_NULL; strm.opaque = Z_NULL; strm.next_in = Z_NULL;
-				strm.avail_in = til;
+				strm.avail_in = e;
 
 				ret = inflateInit2(&strm, -15); /* 'raw', since we do not have gzip header, or gzip crc. .ZIP files are 'raw' implode data. */
 				if (ret != Z_OK)
 				   perror("Error, initializing the libz inflateInit2() system\n");
 
 				strm.next_in = curDecryBuf;
-				strm.avail_out = sizeof(curInfBuf);
-				strm.next_out = curInfBuf;
+				strm.avail_out = sizeof(inflateBufTmp);
+				strm.next_out = inflateBufTmp;
 
 				ret = inflate(&strm, Z_SYNC_FLUSH);
-
 				inflateEnd(&strm);
-				if (ret != Z_OK) {
-					// we need to handle zips smaller than sizeof curInfBuf.  If we find a zip of this
-					// size, the return is Z_STREAM_END, BUT things are fine.
-					if (ret == Z_STREAM_END && salt->deCompLen == strm.total_out)
-						; // things are ok.
-					else
-					goto Failed_Bailout;
-				}
-				if (!strm.total_out)
-					goto Failed_Bailout;
 
-				ret = salt->H[cur_hash_idx].pSig->max_len;
-				if (salt->H[cur_hash_idx].magic == 255) {
-					if (!validate_ascii(curInfBuf, strm.total_out))
-						goto Failed_Bailout;
-				} else {
-					if (strm.total_out < ret)
-						goto Failed_Bailout;
-					if (!CheckSigs(curInfBuf, strm.total_out, salt->H[cur_hash_idx].pSig))
-						goto Failed_Bailout;
-				}
-			}
-#endif
-
-			if (salt->H[cur_hash_idx].full_zip) {
-				u8 inflateBufTmp[1024];
-				if (salt->compLen > 240 && salt->H[cur_hash_idx].datlen >= 200) {
-					for (;e < 200;) {
-						key0.u = pkzip_crc32 (key0.u, curDecryBuf[e]);
-						key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-						key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
-						curDecryBuf[++e] = PKZ_MULT(*b++,key2);
-					}
-					strm.zalloc = Z_NULL; strm.zfree = Z_NULL; strm.opaque = Z_NULL; strm.next_in = Z_NULL;
-					strm.avail_in = e;
-
-					ret = inflateInit2(&strm, -15); /* 'raw', since we do not have gzip header, or gzip crc. .ZIP files are 'raw' implode data. */
-					if (ret != Z_OK)
-					   perror("Error, initializing the libz inflateInit2() system\n");
-
-					strm.next_in = curDecryBuf;
-					strm.avail_out = sizeof(inflateBufTmp);
-					strm.next_out = inflateBufTmp;
-
-					ret = inflate(&strm, Z_SYNC_FLUSH);
-					inflateEnd(&strm);
-
-					if (ret != Z_OK) {
+				if (ret != Z_OK) {
 #if (ZIP_DEBUG==2)
-						fprintf(stderr, "fail=%d fail2=%d tot=%lld\n", ++FAILED, FAILED2, ((long long)CNT)*_count);
+					fprintf(stderr, "fail=%d fail2=%d tot=%lld\n", ++FAILED, FAILED2, (long long)CNT);
 #endif
-						goto Failed_Bailout;
-					}
+					return 0;
 				}
-				goto KnownSuccess;
 			}
+			return 1;
 		}
-		while(--cur_hash_count);
+	}
+	while(--cur_hash_count);
 
-		/* We got a checksum HIT!!!! All hash checksums matched. */
-		/* We load the proper checksum value for the gethash */
-KnownSuccess: ;
-		chk[idx] = 1;
+	/* We got a checksum HIT!!!! All hash checksums matched. */
+	return 1;
+}
 
-		continue;
+/*
+ * Crypt_all performs the .zip validation of the data for ALL hashes provided, in
+ * the 2 stages described above.  chk[] gets a 1 for each password where every
+ * hash passed, and cmp_all/cmp_one simply report that.  NOTE, this does not mean
+ * we have found the password (unless a full file check was done).  Just that all
+ * hashes quick checks for this password 'work'.
+ */
+static int crypt_all(int *pcount, struct db_salt *_salt)
+{
+	int _count = *pcount;
+	int idx, ncand = 0;
+#if (ZIP_DEBUG==2)
+	CNT += _count;
+#endif
+
+	// Stage 1. Every candidate gets the same (small) amount of work here, so this
+	// loop spreads over threads evenly.
+#ifdef _OPENMP
+#pragma omp parallel for private(idx)
+#endif
+	for (idx = 0; idx < _count; ++idx) {
+		if (dirty) {
+			u8 *p = (u8*)saved_key[idx];
+			MY_WORD key0, key1, key2;
 
-Failed_Bailout: ;
-		/* We load the wrong checksum value for the gethash */
-		chk[idx] = 0;
+			/* load the 'pwkey' one time, put it into the K12 array */
+			key0.u = 0x12345678UL; key1.u = 0x23456789UL; key2.u = 0x34567890UL;
+			do {
+				key0.u = pkzip_crc32 (key0.u, *p++);
+				key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+				key2.u = pkzip_crc32 (key2.u, key1.c[KB2]);
+			} while (*p);
+			K12[idx*3] = key0.u, K12[idx*3+1] = key1.u, K12[idx*3+2] = key2.u;
+		}
+		chk[idx] = check_checksums(idx);
 	}
 
 	/* clear the 'dirty' flag.  Then on multiple different salt calls, we will not have to */
 	/* encrypt the passwords again. They will have already been loaded in the K12[] array. */
 	dirty = 0;
 
+	// compact the survivors, so stage 2 only iterates (and threads) over them.
+	for (idx = 0; idx < _count; ++idx)
+		if (chk[idx])
+			cand[ncand++] = idx;
+	if (!ncand)
+		return _count;
+
+	// Stage 2.
+#ifdef _OPENMP
+#pragma omp parallel for private(idx)
+#endif
+	for (idx = 0; idx < ncand; ++idx)
+		chk[cand[idx]] = check_password(cand[idx]);
+
 	return _count;
 }
 
@@ -1667,7 +1802,7 @@ struct fmt_main fmt_pkzip = {
 		tests
 	}, {
 		init,
-		fmt_default_done,
+		done,
 		fmt_default_reset,
 		fmt_default_prepare,
 		valid,
@@ -106,6 +106,8 @@
 #if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
 #include <unistd.h>
 #endif
+#include <sys/stat.h>
+#include <stddef.h>
 
 #include "arch.h"
 #include "jumbo.h"
@@ -130,6 +132,9 @@
 #include "rpp.h"
 #include "rules.h"
 #include "mask.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "memdbg.h"
 
 #define _STR_VALUE(arg) #arg
@@ -140,6 +145,7 @@ int prince_elem_cnt_max;
 int prince_wl_max;
 char *prince_skip_str;
 char *prince_limit_str;
+char *prince_cache_str;
 
 static char *mem_map, *map_pos, *map_end;
 #endif
@@ -166,6 +172,10 @@ static char *mem_map, *map_pos, *map_end;
 
 #define ENTRY_END_HASH   0xFFFFFFFF
 
+#if defined(JTR_MODE) && defined(_OPENMP)
+#define OMP_BATCH_CNT    0x1000 /* Candidates per thread per batch */
+#endif
+
 #define MIN(a,b) (((a) < (b)) ? (a) : (b))
 #define MAX(a,b) (((a) > (b)) ? (a) : (b))
 
@@ -698,6 +708,54 @@ static void chain_set_pwbuf_increment (const chain_t *chain_buf, const db_entry_
   }
 }
 
+#if defined(JTR_MODE) && defined(_OPENMP)
+/*
+ * Generate cnt consecutive candidates of a chain, starting at keyspace
+ * position ks_pos + offset, into batch_buf (pw_len bytes each, no
+ * terminator). Each thread derives its own start position from the
+ * keyspace position so the output is identical to serial generation.
+ */
+static void chain_set_pwbuf_batch (const chain_t *chain_buf, const db_entry_t *db_entries, mpz_t *ks_pos, const u64 offset, const u64 cnt, const int pw_len, char *batch_buf)
+{
+#pragma omp parallel
+  {
+    const int t_cnt = omp_get_num_threads ();
+    const int t_num = omp_get_thread_num ();
+
+    const u64 per_thread = (cnt + t_cnt - 1) / t_cnt;
+
+    const u64 start = MIN (cnt, t_num * per_thread);
+    const u64 end   = MIN (cnt, start + per_thread);
+
+    if (start < end)
+    {
+      u64 ks_poses[OUT_LEN_MAX];
+
+      mpz_t pos; mpz_init_set (pos, *ks_pos);
+
+      mpz_add_ui (pos, pos, offset + start);
+
+      set_chain_ks_poses (chain_buf, db_entries, &pos, ks_poses);
+
+      char *pw_buf = batch_buf + start * pw_len;
+
+      chain_set_pwbuf_init (chain_buf, db_entries, ks_poses, pw_buf);
+
+      for (u64 idx = start + 1; idx < end; idx++)
+      {
+        memcpy (pw_buf + pw_len, pw_buf, pw_len);
+
+        pw_buf += pw_len;
+
+        chain_set_pwbuf_increment (chain_buf, db_entries, ks_poses, pw_buf);
+      }
+
+      mpz_clear (pos);
+    }
+  }
+}
+#endif
+
 static void chain_gen_with_idx (chain_t *chain_buf, const int len1, const int chains_idx)
 {
   chain_buf->cnt = 0;
@@ -983,6 +1041,229 @@ static MAYBE_INLINE char *mgets(int *len)
   return pos;
 }
 
+/*
+ * PRINCE cache file (--prince-cache). A header followed by, for each
+ * length, the processed elements (packed, pw_len bytes each) and then the
+ * chain table (a count byte plus pw_len element lengths per chain). The
+ * layout is used in place from a memory mapping.
+ */
+#define CACHE_MAGIC   "JtRPrnc"
+#define CACHE_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  u64  version;
+
+  /* Everything up to elems_cnt is the cache key */
+  u64  file_size;
+  u64  file_mtime;
+  u64  path_hash;
+  u64  wl_max;
+  u64  pw_min;
+  u64  pw_max;
+  u64  elem_cnt_min;
+  u64  elem_cnt_max;
+  u64  case_permute;
+  u64  dupe_check;
+  u64  loopback;
+  u64  input_enc;
+  u64  target_enc;
+
+  u64  elems_cnt[OUT_LEN_MAX + 1];
+  u64  chains_cnt[OUT_LEN_MAX + 1];
+
+} cache_hdr_t;
+
+#define CACHE_KEY_SIZE offsetof(cache_hdr_t, elems_cnt)
+
+static char *cache_map;
+static size_t cache_len;
+
+static u64 cache_path_hash (const char *path)
+{
+  u64 h = 0xcbf29ce484222325ULL;
+
+  while (*path)
+  {
+    h ^= (u8) *path++;
+    h *= 0x100000001b3ULL;
+  }
+
+  return h;
+}
+
+/* Returns 1 if the cache was valid and db_entries are now populated from it */
+static int cache_load (const char *name, const cache_hdr_t *key, db_entry_t *db_entries)
+{
+  const cache_hdr_t *hdr;
+  struct stat st;
+  FILE *fp;
+
+  if (!(fp = jtr_fopen(name, "rb")))
+    return 0;
+
+  if (fstat(fileno(fp), &st) || st.st_size < (off_t) sizeof(cache_hdr_t))
+  {
+    fclose(fp);
+    return 0;
+  }
+
+  cache_len = st.st_size;
+
+#ifdef HAVE_MMAP
+  cache_map = mmap(NULL, cache_len, PROT_READ, MAP_SHARED, fileno(fp), 0);
+  if (cache_map == MAP_FAILED)
+    cache_map = NULL;
+#else
+  cache_map = mem_alloc(cache_len);
+  if (fread(cache_map, 1, cache_len, fp) != cache_len)
+  {
+    free(cache_map);
+    cache_map = NULL;
+  }
+#endif
+  fclose(fp);
+
+  if (!cache_map)
+    return 0;
+
+  hdr = (const cache_hdr_t *) cache_map;
+
+  size_t need = sizeof(cache_hdr_t);
+
+  if (memcmp(hdr, key, CACHE_KEY_SIZE))
+    goto invalid;
+
+  for (int pw_len = IN_LEN_MIN; pw_len <= key->pw_max; pw_len++)
+  {
+    need += hdr->elems_cnt[pw_len] * pw_len;
+    need += hdr->chains_cnt[pw_len] * (pw_len + 1);
+  }
+
+  if (need != cache_len)
+    goto invalid;
+
+  u8 *pos = (u8 *) cache_map + sizeof(cache_hdr_t);
+
+  for (int pw_len = IN_LEN_MIN; pw_len <= key->pw_max; pw_len++)
+  {
+    db_entry_t *db_entry = &db_entries[pw_len];
+
+    const u64 elems_cnt = hdr->elems_cnt[pw_len];
+
+    if (elems_cnt)
+    {
+      db_entry->elems_buf = (elem_t *) mem_alloc (elems_cnt * sizeof (elem_t));
+
+      for (u64 idx = 0; idx < elems_cnt; idx++, pos += pw_len)
+      {
+        db_entry->elems_buf[idx].buf = pos;
+      }
+    }
+
+    db_entry->elems_cnt   = elems_cnt;
+    db_entry->elems_alloc = elems_cnt;
+
+    const int chains_cnt = hdr->chains_cnt[pw_len];
+
+    if (chains_cnt)
+    {
+      db_entry->chains_buf = (chain_t *) mem_calloc (chains_cnt * sizeof (chain_t));
+
+      for (int idx = 0; idx < chains_cnt; idx++, pos += pw_len + 1)
+      {
+        chain_t *chain_buf = &db_entry->chains_buf[idx];
+
+        chain_buf->cnt = pos[0];
+        chain_buf->buf = pos + 1;
+
+        mpz_init_set_si (chain_buf->ks_cnt, 0);
+        mpz_init_set_si (chain_buf->ks_pos, 0);
+      }
+    }
+
+    db_entry->chains_cnt   = chains_cnt;
+    db_entry->chains_alloc = chains_cnt;
+  }
+
+  return 1;
+
+invalid:
+#ifdef HAVE_MMAP
+  munmap(cache_map, cache_len);
+  cache_map = NULL;
+#else
+  free(cache_map);
+  cache_map = NULL;
+#endif
+  return 0;
+}
+
+static void cache_save (const char *name, cache_hdr_t *hdr, const db_entry_t *db_entries)
+{
+  char tmp_name[PATH_BUFFER_SIZE + 16];
+  FILE *fp;
+
+  for (int pw_len = IN_LEN_MIN; pw_len <= hdr->pw_max; pw_len++)
+  {
+    hdr->elems_cnt[pw_len]  = db_entries[pw_len].elems_cnt;
+    hdr->chains_cnt[pw_len] = db_entries[pw_len].chains_cnt;
+  }
+
+  /* Write to a private name first; other nodes may be reading the cache */
+  snprintf(tmp_name, sizeof(tmp_name), "%s.%u", name, (unsigned) getpid());
+
+  if (!(fp = jtr_fopen(tmp_name, "wb")))
+  {
+    log_event("! Can't create PRINCE cache %.100s: %s", tmp_name, strerror(errno));
+    return;
+  }
+
+  int ok = fwrite(hdr, sizeof(cache_hdr_t), 1, fp) == 1;
+
+  for (int pw_len = IN_LEN_MIN; ok && pw_len <= hdr->pw_max; pw_len++)
+  {
+    const db_entry_t *db_entry = &db_entries[pw_len];
+
+    for (u64 idx = 0; ok && idx < db_entry->elems_cnt; idx++)
+    {
+      ok = fwrite(db_entry->elems_buf[idx].buf, pw_len, 1, fp) == 1;
+    }
+
+    for (int idx = 0; ok && idx < db_entry->chains_cnt; idx++)
+    {
+      const chain_t *chain_buf = &db_entry->chains_buf[idx];
+
+      u8 rec[OUT_LEN_MAX + 1];
+
+      memset (rec, 0, pw_len + 1);
+
+      rec[0] = chain_buf->cnt;
+
+      memcpy (rec + 1, chain_buf->buf, chain_buf->cnt);
+
+      ok = fwrite(rec, pw_len + 1, 1, fp) == 1;
+    }
+  }
+
+  if (fclose(fp) || !ok)
+  {
+    log_event("! Failed writing PRINCE cache %.100s", tmp_name);
+    unlink(tmp_name);
+    return;
+  }
+
+  if (rename(tmp_name, name))
+  {
+    log_event("! Can't rename PRINCE cache to %.100s: %s", name, strerror(errno));
+    unlink(tmp_name);
+    return;
+  }
+
+  log_event("- Wrote PRINCE cache %.100s", name);
+}
+
 void do_prince_crack(struct db_main *db, char *wordlist, int rules)
 #endif
 {
@@ -1392,14 +1673,55 @@ void do_prince_crack(struct db_main *db, char *wordlist, int rules)
     char *input_buf = fgets (buf, sizeof (buf), read_fp);
 #else
   FILE *read_fp;
-  uint64_t file_len;
+  uint64_t file_len = 0;
+  size_t uniq_mem = 0;
+  cache_hdr_t cache_hdr;
   int warn = cfg_get_bool(SECTION_OPTIONS, NULL, "WarnEncoding", 0);
 
   if (!john_main_process)
     warn = 0;
 
+  /* path_expand() returns a static buffer, so copy this one first */
+  if (prince_cache_str)
+    prince_cache_str = str_alloc_copy(path_expand(prince_cache_str));
+
   wordlist = path_expand(wordlist);
 
+  if (prince_cache_str)
+  {
+    struct stat st;
+
+    if (stat(wordlist, &st))
+      pexit("stat: %s", wordlist);
+
+    memset(&cache_hdr, 0, sizeof(cache_hdr));
+    memcpy(cache_hdr.magic, CACHE_MAGIC, sizeof(cache_hdr.magic));
+    cache_hdr.version      = CACHE_VERSION;
+    cache_hdr.file_size    = st.st_size;
+    cache_hdr.file_mtime   = st.st_mtime;
+    cache_hdr.path_hash    = cache_path_hash(wordlist);
+    cache_hdr.wl_max       = wl_max;
+    cache_hdr.pw_min       = pw_min;
+    cache_hdr.pw_max       = pw_max;
+    cache_hdr.elem_cnt_min = elem_cnt_min;
+    cache_hdr.elem_cnt_max = elem_cnt_max;
+    cache_hdr.case_permute = case_permute;
+    cache_hdr.dupe_check   = dupe_check;
+    cache_hdr.loopback     = loopback;
+    cache_hdr.input_enc    = pers_opts.input_enc;
+    cache_hdr.target_enc   = pers_opts.target_enc;
+
+    if (cache_load(prince_cache_str, &cache_hdr, db_entries))
+    {
+      log_event("- Loaded elements and chains from PRINCE cache %.100s",
+                prince_cache_str);
+      goto cache_loaded;
+    }
+
+    log_event("- PRINCE cache %.100s missing or stale, will rebuild",
+              prince_cache_str);
+  }
+
   if (!(read_fp = jtr_fopen(wordlist, "rb")))
     pexit(STR_MACRO(jtr_fopen)": %s", wordlist);
   log_event("- Input file: %.100s", wordlist);
@@ -1448,8 +1770,6 @@ void do_prince_crack(struct db_main *db, char *wordlist, int rules)
   if (case_permute)
     log_event("- Permuting case of 1st character");
 
-  size_t uniq_mem = 0;
-
   if (dupe_check) {
     long size = file_len / pw_max;
 
@@ -1703,6 +2023,13 @@ void do_prince_crack(struct db_main *db, char *wordlist, int rules)
     memset (db_entry->cur_chain_ks_poses, 0, OUT_LEN_MAX * sizeof (u64));
   }
 
+#ifdef JTR_MODE
+  if (prince_cache_str && john_main_process)
+    cache_save(prince_cache_str, &cache_hdr, db_entries);
+
+cache_loaded:
+#endif
+
   /**
    * calculate password candidate output length distribution
    */
@@ -2054,9 +2381,22 @@ void do_prince_crack(struct db_main *db, char *wordlist, int rules)
     log_event("- Limit %s", l_msg);
   }
 
-  log_event("Starting candidate generation");
-
   int jtr_done = 0;
+
+#ifdef _OPENMP
+  const int omp_t = omp_get_max_threads();
+  const u64 batch_max = (u64) omp_t * OMP_BATCH_CNT;
+  char *batch_buf = NULL;
+
+  if (omp_t > 1)
+  {
+    batch_buf = mem_alloc (batch_max * pw_max);
+
+    log_event("- Generating chain elements using %d OpenMP threads", omp_t);
+  }
+#endif
+
+  log_event("Starting candidate generation");
 #endif
   while (mpz_cmp (total_ks_pos, total_ks_cnt) < 0)
   {
@@ -2139,12 +2479,35 @@ void do_prince_crack(struct db_main *db, char *wordlist, int rules)
             set_chain_ks_poses (chain_buf, db_entries, &tmp, db_entry->cur_chain_ks_poses);
           }
 
-          chain_set_pwbuf_init (chain_buf, db_entries, db_entry->cur_chain_ks_poses, pw_buf);
-
           const u64 iter_pos_save = iter_max_u64 - iter_pos_u64;
 
+#if defined(JTR_MODE) && defined(_OPENMP)
+          /* Only worth it if every thread gets some work */
+          const int use_batch = batch_buf && iter_pos_save >= (u64) omp_t * 0x40;
+          u64 batch_pos = 0, batch_cnt = 0;
+
+          if (!use_batch)
+#endif
+          chain_set_pwbuf_init (chain_buf, db_entries, db_entry->cur_chain_ks_poses, pw_buf);
+
           while (iter_pos_u64 < iter_max_u64)
           {
+#if defined(JTR_MODE) && defined(_OPENMP)
+            if (use_batch)
+            {
+              if (batch_pos == batch_cnt)
+              {
+                batch_cnt = MIN (iter_max_u64 - iter_pos_u64, batch_max);
+                batch_pos = 0;
+
+                chain_set_pwbuf_batch (chain_buf, db_entries, &chain_buf->ks_pos, iter_pos_u64, batch_cnt, pw_len, batch_buf);
+              }
+
+              memcpy (pw_buf, batch_buf + batch_pos++ * pw_len, pw_len);
+
+              pw_buf[pw_len] = '\0';
+            }
+#endif
 #ifndef JTR_MODE
             out_push (out, pw_buf, pw_len + 1);
 #else
@@ -2209,11 +2572,24 @@ next_rule:
             }
 #endif
 
+#if defined(JTR_MODE) && defined(_OPENMP)
+            if (!use_batch)
+#endif
             chain_set_pwbuf_increment (chain_buf, db_entries, db_entry->cur_chain_ks_poses, pw_buf);
 
             iter_pos_u64++;
           }
 
+#if defined(JTR_MODE) && defined(_OPENMP)
+          /* Leave the chain where serial generation would have left it */
+          if (use_batch)
+          {
+            mpz_add (tmp, chain_buf->ks_pos, iter_max);
+
+            set_chain_ks_poses (chain_buf, db_entries, &tmp, db_entry->cur_chain_ks_poses);
+          }
+#endif
+
           mpz_add_ui (save, save, iter_pos_save);
 #ifdef JTR_MODE
           if (jtr_done || event_abort)
@@ -2320,9 +2696,23 @@ next_rule:
 #ifndef JTR_MODE
   return 0;
 #else
+#ifdef _OPENMP
+  MEM_FREE(batch_buf);
+#endif
   if (mem_map)
     munmap(mem_map, file_len);
 
+  if (cache_map)
+  {
+#ifdef HAVE_MMAP
+    munmap(cache_map, cache_len);
+    cache_map = NULL;
+#else
+    free(cache_map);
+    cache_map = NULL;
+#endif
+  }
+
   crk_done();
   rec_done(event_abort || (status.pass && db->salts));
 
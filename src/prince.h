@@ -30,4 +30,7 @@ extern char *prince_limit_str;
 /* If non-zero, only load this many words from wordlist */
 extern int prince_wl_max;
 
+/* File name for caching processed elements and chains between runs */
+extern char *prince_cache_str;
+
 #endif /* _JOHN_PRINCE_H */
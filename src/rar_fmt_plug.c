@@ -81,13 +81,20 @@ john_register_one(&fmt_rar);
 #include "options.h"
 #include "unicode.h"
 #include "johnswap.h"
+#include "sse-intrinsics.h"
 #include "unrar.h"
 #include "config.h"
 #include "jumbo.h"
 
 #define FORMAT_LABEL		"rar"
 #define FORMAT_NAME		"RAR3"
+#ifdef MMX_COEF
+#define NBKEYS			(MMX_COEF * SHA1_SSE_PARA)
+#define ALGORITHM_NAME		"SHA1 " SHA1_ALGORITHM_NAME " AES"
+#else
+#define NBKEYS			1
 #define ALGORITHM_NAME		"SHA1 AES 32/" ARCH_BITS_STR
+#endif
 
 #ifdef DEBUG
 #define BENCHMARK_COMMENT	" (1-16 characters)"
@@ -102,8 +109,8 @@ john_register_one(&fmt_rar);
 #define BINARY_ALIGN		MEM_ALIGN_NONE
 #define SALT_SIZE		sizeof(rarfile*)
 #define SALT_ALIGN		sizeof(rarfile*)
-#define MIN_KEYS_PER_CRYPT	1
-#define MAX_KEYS_PER_CRYPT	1
+#define MIN_KEYS_PER_CRYPT	NBKEYS
+#define MAX_KEYS_PER_CRYPT	NBKEYS
 
 #define ROUNDS			0x40000
 
@@ -135,6 +142,10 @@ static unpack_data_t (*unpack_data);
 static unsigned int *saved_len;
 static unsigned char *aes_key;
 static unsigned char *aes_iv;
+#ifdef MMX_COEF
+static int *key_order;
+#endif
+static int *survivors;
 
 typedef struct {
 	dyna_salt dsalt; /* must be first. allows dyna_salt to work */
@@ -359,12 +370,19 @@ static void *get_salt(char *ciphertext)
 			                   PROT_READ, MAP_SHARED,
 			                   fileno(fp), 0);
 			if (psalt->blob == MAP_FAILED) {
-				fprintf(stderr, "Error loading file from "
-				        "archive '%s'. Archive possibly "
-				        "damaged.\n", archive_name);
-				error();
-			}
-			psalt->blob += pos;
+				/* Could not map it (address space, file
+				   system), so read the payload once instead */
+				size_t count;
+
+				psalt->blob = mem_alloc(psalt->pack_size);
+				jtr_fseek64(fp, pos, SEEK_SET);
+				count = fread(psalt->blob, 1, psalt->pack_size, fp);
+				if (count != psalt->pack_size) {
+					fprintf(stderr, "Error loading file from archive '%s', expected %llu bytes, got %zu. Archive possibly damaged.\n", archive_name, psalt->pack_size, count);
+					error();
+				}
+			} else
+				psalt->blob += pos;
 #else
 			size_t count;
 
@@ -431,6 +449,10 @@ static void init(struct fmt_main *self)
 	saved_salt = mem_calloc_tiny(8, MEM_ALIGN_NONE);
 	aes_key = mem_calloc_tiny(16 * self->params.max_keys_per_crypt, MEM_ALIGN_NONE);
 	aes_iv = mem_calloc_tiny(16 * self->params.max_keys_per_crypt, MEM_ALIGN_NONE);
+#ifdef MMX_COEF
+	key_order = mem_calloc_tiny(sizeof(*key_order) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+#endif
+	survivors = mem_calloc_tiny(sizeof(*survivors) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 
 #ifdef DEBUG
 	self->params.benchmark_comment = " (1-16 characters)";
@@ -657,11 +679,261 @@ static MAYBE_INLINE int check_huffman(unsigned char *next) {
 	return 1; /* Passed this check! */
 }
 
+#ifdef MMX_COEF
+/*
+ * Multi-buffer version of the key derivation below. 64 rounds of RawPsw
+ * always fill a whole number of SHA1 blocks, so each lane gets a buffer
+ * with 64 copies of its RawPsw and only the round counters are patched
+ * between periods. The lanes then step through their own buffer one block
+ * per SSESHA1body call. IV snapshots fall mid-block, so for those we pull
+ * the lane's state out and finish it with scalar SHA1 on the partial block.
+ * Keys are sorted by length first, so lanes in a batch normally finish
+ * together.
+ */
+#define PERIODS		(ROUNDS / 64)
+#define STATE_POS(j, w)	(((j) / MMX_COEF) * 5 * MMX_COEF + (w) * MMX_COEF + ((j) & (MMX_COEF - 1)))
+#define BLOCK_POS(j, w)	(((j) / MMX_COEF) * SHA_BUF_SIZ * MMX_COEF + (w) * MMX_COEF + ((j) & (MMX_COEF - 1)))
+
+static void sort_by_length(int count)
+{
+	unsigned int first[UNICODE_LENGTH + 2];
+	int index;
+
+	memset(first, 0, sizeof(first));
+	for (index = 0; index < count; index++)
+		first[saved_len[index] + 1]++;
+	for (index = 1; index <= UNICODE_LENGTH + 1; index++)
+		first[index] += first[index - 1];
+	for (index = 0; index < count; index++)
+		key_order[first[saved_len[index]]++] = index;
+}
+
+static void lane_final(ARCH_WORD_32 *state, int j, unsigned int blocks,
+                       unsigned char *data, unsigned int len,
+                       unsigned char *out)
+{
+	SHA_CTX ctx;
+
+	SHA1_Init(&ctx);
+	ctx.h0 = state[STATE_POS(j, 0)];
+	ctx.h1 = state[STATE_POS(j, 1)];
+	ctx.h2 = state[STATE_POS(j, 2)];
+	ctx.h3 = state[STATE_POS(j, 3)];
+	ctx.h4 = state[STATE_POS(j, 4)];
+	ctx.Nl = blocks << 9;
+	ctx.Nh = blocks >> 23;
+	SHA1_Update(&ctx, data, len);
+	SHA1_Final(out, &ctx);
+}
+
+static void crypt_sse(const int *order, int n)
+{
+	static const ARCH_WORD_32 sha1_iv[5] = {
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+	JTR_ALIGN(16) ARCH_WORD_32 block[NBKEYS * SHA_BUF_SIZ];
+	JTR_ALIGN(16) ARCH_WORD_32 state[NBKEYS * 5];
+	struct {
+		ARCH_WORD_32 *stream;
+		unsigned int RawLength, period, blk;
+	} lane[NBKEYS];
+	ARCH_WORD_32 *streams;
+	unsigned int i;
+	int j, active = n;
+
+	streams = mem_alloc(n * 64 * (UNICODE_LENGTH + 8 + 3));
+	for (j = 0; j < n; j++) {
+		int index = order[j];
+		unsigned char *p;
+
+		lane[j].RawLength = saved_len[index] + 8 + 3;
+		lane[j].stream = j ? lane[j - 1].stream +
+			16 * lane[j - 1].RawLength : streams;
+		lane[j].period = lane[j].blk = 0;
+		p = (unsigned char*)lane[j].stream;
+		for (i = 0; i < 64; i++) {
+			memcpy(p, &saved_key[UNICODE_LENGTH * index], saved_len[index]);
+			memcpy(p + saved_len[index], saved_salt, 8);
+			p += lane[j].RawLength;
+		}
+	}
+	for (j = 0; j < NBKEYS; j++)
+		for (i = 0; i < 5; i++)
+			state[STATE_POS(j, i)] = sha1_iv[i];
+
+	while (active) {
+		for (j = 0; j < n; j++) {
+			unsigned int L = lane[j].RawLength;
+			unsigned int period = lane[j].period;
+			ARCH_WORD_32 *data;
+
+			if (period == PERIODS)
+				continue;
+			if (lane[j].blk == 0) {
+				unsigned char *PswNum = (unsigned char*)lane[j].stream + L - 3;
+
+				for (i = period * 64; i < period * 64 + 64; i++) {
+					PswNum[0] = (unsigned char) i;
+					PswNum[1] = (unsigned char) (i >> 8);
+					PswNum[2] = (unsigned char) (i >> 16);
+					PswNum += L;
+				}
+			}
+			data = &lane[j].stream[16 * lane[j].blk];
+			/* Round i with i % (ROUNDS / 16) == 0 is the first of its period */
+			if (period % (PERIODS / 16) == 0 && lane[j].blk == L / 64) {
+				unsigned char tempout[20];
+
+				lane_final(state, j, period * L + lane[j].blk,
+				           (unsigned char*)data, L % 64, tempout);
+				aes_iv[order[j] * 16 + period / (PERIODS / 16)] = tempout[19];
+			}
+			for (i = 0; i < 16; i++)
+				block[BLOCK_POS(j, i)] = JOHNSWAP(data[i]);
+		}
+		SSESHA1body((__m128i*)block, state, state, SSEi_MIXED_IN|SSEi_RELOAD);
+		for (j = 0; j < n; j++) {
+			if (lane[j].period == PERIODS || ++lane[j].blk < lane[j].RawLength)
+				continue;
+			lane[j].blk = 0;
+			if (++lane[j].period == PERIODS) {
+				unsigned int digest[5];
+
+				lane_final(state, j, PERIODS * lane[j].RawLength,
+				           NULL, 0, (unsigned char*)digest);
+				for (i = 0; i < 4; i++)	/* reverse byte order */
+					digest[i] = JOHNSWAP(digest[i]);
+				memcpy(&aes_key[order[j] * 16], (unsigned char*)digest, 16);
+				active--;
+			}
+		}
+	}
+	MEM_FREE(streams);
+}
+#undef PERIODS
+#undef STATE_POS
+#undef BLOCK_POS
+#endif
+
+/*
+ * Candidates are verified in two stages.  quick_check() decrypts only the
+ * first AES block, which is the whole check for rar-hp and is enough for the
+ * PPM flag / Huffman table early rejection of compressed files.  Stored files
+ * have no such cheap test, so they all go on to full_check(), which does the
+ * full decryption with CRC check (or unpack and CRC for compressed files).
+ */
+static int quick_check(int index)
+{
+	int i16 = index*16;
+	int outlen = 0;
+	unsigned char plain[16 + 16];
+	EVP_CIPHER_CTX aes_ctx;
+
+	if (cur_file->type && cur_file->method == 0x30)
+		return 1;
+
+	EVP_CIPHER_CTX_init(&aes_ctx);
+	EVP_DecryptInit_ex(&aes_ctx, EVP_aes_128_cbc(), NULL, &aes_key[i16], &aes_iv[i16]);
+	EVP_CIPHER_CTX_set_padding(&aes_ctx, 0);
+	EVP_DecryptUpdate(&aes_ctx, plain, &outlen, cur_file->blob, 16);
+	EVP_DecryptFinal_ex(&aes_ctx, &plain[outlen], &outlen);
+	EVP_CIPHER_CTX_cleanup(&aes_ctx);
+
+	if (cur_file->type == 0)	/* rar-hp mode */
+		return !memcmp(plain, "\xc4\x3d\x7b\x00\x40\x07\x00", 7);
+
+	if (plain[0] & 0x80) {
+		// PPM checks here.
+		if (!(plain[0] & 0x20) ||  // Reset bit must be set
+		    (plain[1] & 0x80))     // MaxMB must be < 128
+			return 0;
+	} else {
+		// LZ checks here.
+		if ((plain[0] & 0x40) ||   // KeepOldTable can't be set
+		    !check_huffman(plain)) // Huffman table check
+			return 0;
+	}
+	return 1;
+}
+
+static int full_check(int index)
+{
+	int i16 = index*16;
+	unsigned int inlen;
+	int outlen, ret = 0;
+	EVP_CIPHER_CTX aes_ctx;
+
+	EVP_CIPHER_CTX_init(&aes_ctx);
+	EVP_DecryptInit_ex(&aes_ctx, EVP_aes_128_cbc(), NULL, &aes_key[i16], &aes_iv[i16]);
+	EVP_CIPHER_CTX_set_padding(&aes_ctx, 0);
+
+	if (cur_file->method == 0x30) {	/* stored, not deflated */
+		CRC32_t crc;
+		unsigned char crc_out[4];
+		unsigned char plain[0x8010];
+		unsigned long long size = cur_file->unp_size;
+		unsigned char *cipher = cur_file->blob;
+
+		/* Use full decryption with CRC check.
+		   Compute CRC of the decompressed plaintext */
+		CRC32_Init(&crc);
+		outlen = 0;
+
+		while (size > 0x8000) {
+			inlen = 0x8000;
+
+			EVP_DecryptUpdate(&aes_ctx, plain, &outlen, cipher, inlen);
+			CRC32_Update(&crc, plain, outlen > size ? size : outlen);
+			size -= outlen;
+			cipher += inlen;
+		}
+		EVP_DecryptUpdate(&aes_ctx, plain, &outlen, cipher, (size + 15) & ~0xf);
+		EVP_DecryptFinal_ex(&aes_ctx, &plain[outlen], &outlen);
+		size += outlen;
+		CRC32_Update(&crc, plain, size);
+		CRC32_Final(crc_out, crc);
+
+		/* Compare computed CRC with stored CRC */
+		ret = !memcmp(crc_out, &cur_file->crc.c, 4);
+	} else {
+		const int solid = 0;
+		unpack_data_t *unpack_t;
+
+#ifdef _OPENMP
+		unpack_t = &unpack_data[omp_get_thread_num()];
+#else
+		unpack_t = unpack_data;
+#endif
+		unpack_t->max_size = cur_file->unp_size;
+		unpack_t->dest_unp_size = cur_file->unp_size;
+		unpack_t->pack_size = cur_file->pack_size;
+		unpack_t->iv = &aes_iv[i16];
+		unpack_t->ctx = &aes_ctx;
+		unpack_t->key = &aes_key[i16];
+
+		if (rar_unpack29(cur_file->blob, solid, unpack_t))
+			ret = !memcmp(&unpack_t->unp_crc, &cur_file->crc.c, 4);
+	}
+	EVP_CIPHER_CTX_cleanup(&aes_ctx);
+	return ret;
+}
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	int count = *pcount;
-	int index = 0;
+	int index = 0, nsurv;
+
+#ifdef MMX_COEF
+	int loops = (count + NBKEYS - 1) / NBKEYS;
 
+	sort_by_length(count);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < loops; index++)
+		crypt_sse(&key_order[index * NBKEYS],
+		          MIN(NBKEYS, count - index * NBKEYS));
+#else
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
@@ -701,110 +973,32 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 			digest[i] = JOHNSWAP(digest[i]);
 		memcpy(&aes_key[i16], (unsigned char*)digest, 16);
 	}
+#endif
 
+	/* Stage 1: a single AES block for every candidate */
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-	for (index = 0; index < count; index++) {
-		int i16 = index*16;
-		unsigned int inlen = 16;
-		int outlen;
-		EVP_CIPHER_CTX aes_ctx;
-
-		EVP_CIPHER_CTX_init(&aes_ctx);
-		EVP_DecryptInit_ex(&aes_ctx, EVP_aes_128_cbc(), NULL, &aes_key[i16], &aes_iv[i16]);
-		EVP_CIPHER_CTX_set_padding(&aes_ctx, 0);
-
-		//fprintf(stderr, "key %s\n", utf16_to_enc((UTF16*)&saved_key[index * UNICODE_LENGTH]));
-		/* AES decrypt, uses aes_iv, aes_key and blob */
-		if (cur_file->type == 0) {	/* rar-hp mode */
-			unsigned char plain[16];
-
-			outlen = 0;
-
-			EVP_DecryptUpdate(&aes_ctx, plain, &outlen, cur_file->blob, inlen);
-			EVP_DecryptFinal_ex(&aes_ctx, &plain[outlen], &outlen);
+	for (index = 0; index < count; index++)
+		cracked[index] = quick_check(index);
 
-			cracked[index] = !memcmp(plain, "\xc4\x3d\x7b\x00\x40\x07\x00", 7);
+	/* rar-hp is fully checked by its first block */
+	if (cur_file->type == 0)
+		return count;
 
-		} else {
+	/* Stage 2: full decryption only for the survivors, compacted first so
+	   that they are spread over all threads */
+	nsurv = 0;
+	for (index = 0; index < count; index++)
+		if (cracked[index])
+			survivors[nsurv++] = index;
 
-			if (cur_file->method == 0x30) {	/* stored, not deflated */
-				CRC32_t crc;
-				unsigned char crc_out[4];
-				unsigned char plain[0x8010];
-				unsigned long long size = cur_file->unp_size;
-				unsigned char *cipher = cur_file->blob;
-
-				/* Use full decryption with CRC check.
-				   Compute CRC of the decompressed plaintext */
-				CRC32_Init(&crc);
-				outlen = 0;
-
-				while (size > 0x8000) {
-					inlen = 0x8000;
-
-					EVP_DecryptUpdate(&aes_ctx, plain, &outlen, cipher, inlen);
-					CRC32_Update(&crc, plain, outlen > size ? size : outlen);
-					size -= outlen;
-					cipher += inlen;
-				}
-				EVP_DecryptUpdate(&aes_ctx, plain, &outlen, cipher, (size + 15) & ~0xf);
-				EVP_DecryptFinal_ex(&aes_ctx, &plain[outlen], &outlen);
-				size += outlen;
-				CRC32_Update(&crc, plain, size);
-				CRC32_Final(crc_out, crc);
-
-				/* Compare computed CRC with stored CRC */
-				cracked[index] = !memcmp(crc_out, &cur_file->crc.c, 4);
-			} else {
-				const int solid = 0;
-				unpack_data_t *unpack_t;
-				unsigned char plain[20];
-
-				cracked[index] = 0;
-
-				/* Decrypt just one block for early rejection */
-				outlen = 0;
-				EVP_DecryptUpdate(&aes_ctx, plain, &outlen, cur_file->blob, 16);
-				EVP_DecryptFinal_ex(&aes_ctx, &plain[outlen], &outlen);
-
-#if 1
-				/* Early rejection */
-				if (plain[0] & 0x80) {
-					// PPM checks here.
-					if (!(plain[0] & 0x20) ||  // Reset bit must be set
-					    (plain[1] & 0x80))     // MaxMB must be < 128
-						goto bailOut;
-				} else {
-					// LZ checks here.
-					if ((plain[0] & 0x40) ||   // KeepOldTable can't be set
-					    !check_huffman(plain)) // Huffman table check
-						goto bailOut;
-				}
-#endif
-				/* Reset stuff for full check */
-				EVP_DecryptInit_ex(&aes_ctx, EVP_aes_128_cbc(), NULL, &aes_key[i16], &aes_iv[i16]);
-				EVP_CIPHER_CTX_set_padding(&aes_ctx, 0);
 #ifdef _OPENMP
-				unpack_t = &unpack_data[omp_get_thread_num()];
-#else
-				unpack_t = unpack_data;
+#pragma omp parallel for
 #endif
-				unpack_t->max_size = cur_file->unp_size;
-				unpack_t->dest_unp_size = cur_file->unp_size;
-				unpack_t->pack_size = cur_file->pack_size;
-				unpack_t->iv = &aes_iv[i16];
-				unpack_t->ctx = &aes_ctx;
-				unpack_t->key = &aes_key[i16];
-
-				if (rar_unpack29(cur_file->blob, solid, unpack_t))
-					cracked[index] = !memcmp(&unpack_t->unp_crc, &cur_file->crc.c, 4);
-bailOut:;
-			}
-		}
-		EVP_CIPHER_CTX_cleanup(&aes_ctx);
-	}
+	for (index = 0; index < nsurv; index++)
+		cracked[survivors[index]] = full_check(survivors[index]);
+
 	return count;
 }
 
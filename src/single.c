@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "misc.h"
@@ -39,9 +40,38 @@ static struct rpp_context *rule_ctx;
 
 static int words_pair_max;
 
+/*
+ * When full size buffers for all salts don't fit in SingleMaxBufferSize, only
+ * a window of window_size salts at a time gets them, and we run all rules over
+ * that window before moving on to the next one.  Meanwhile, the other salts
+ * keep buffers of key_count candidates, just to try the guesses made for other
+ * salts.  The windows go through the salts in the order they were loaded in,
+ * which unlike the database order is the same on every run, so a session can
+ * record where its window starts and ends.  Within a window, we keep to the
+ * database order, which some formats depend on.
+ */
+struct single_order {
+	int rank;
+	struct db_salt *salt;
+};
+
+static int window_size, window_count, window_key_count;
+static struct single_order *window;
+static struct db_keys **window_keys, **window_saved;
+static struct single_order *order;
+static int salt_total, window_start, window_end;
+static int restore_start, restore_end;
+static int restore_window;
+
 static void save_state(FILE *file)
 {
 	fprintf(file, "%d\n", rec_rule);
+
+	if (!window || window_start >= salt_total)
+		return;
+	fprintf(file, "%d\n", order[window_start].salt->sequential_id);
+	if (window_end < salt_total)
+		fprintf(file, "%d\n", order[window_end].salt->sequential_id);
 }
 
 static int restore_rule_number(void)
@@ -56,6 +86,12 @@ static int restore_rule_number(void)
 static int restore_state(FILE *file)
 {
 	if (fscanf(file, "%d\n", &rec_rule) != 1) return 1;
+	restore_window = 0;
+	if (fscanf(file, "%d\n", &restore_start) == 1) {
+		restore_window = 1;
+		if (fscanf(file, "%d\n", &restore_end) == 1)
+			restore_window = 2;
+	}
 
 	return restore_rule_number();
 }
@@ -64,20 +100,31 @@ static double get_progress(void)
 {
 	emms();
 
-	return progress ? progress :
-		(double)rule_number / (rule_count + 1) * 100.0;
+	if (progress)
+		return progress;
+
+	if (window)
+		return (window_start + (double)(window_end - window_start) *
+			rule_number / (rule_count + 1)) / salt_total * 100.0;
+
+	return (double)rule_number / (rule_count + 1) * 100.0;
 }
 
-static void single_alloc_keys(struct db_keys **keys)
+static void single_alloc_keys(struct db_keys **keys, int count)
 {
-	int hash_size = sizeof(struct db_keys_hash) +
-		sizeof(struct db_keys_hash_entry) * (key_count - 1);
+	int hash_size;
+
+	if (*keys)
+		count = (*keys)->size;
+	hash_size = sizeof(struct db_keys_hash) +
+		sizeof(struct db_keys_hash_entry) * (count - 1);
 
 	if (!*keys) {
 		*keys = mem_alloc_tiny(
-			sizeof(struct db_keys) - 1 + length * key_count,
+			sizeof(struct db_keys) - 1 + length * count,
 			MEM_ALIGN_WORD);
 		(*keys)->hash = mem_alloc_tiny(hash_size, MEM_ALIGN_WORD);
+		(*keys)->size = count;
 	}
 
 	(*keys)->count = (*keys)->count_from_guesses = 0;
@@ -88,9 +135,63 @@ static void single_alloc_keys(struct db_keys **keys)
 	memset((*keys)->hash, -1, hash_size);
 }
 
+/*
+ * We use "short" for buffered key indices and "unsigned short" for buffered
+ * key offsets - make sure these don't overflow.
+ */
+static int single_limit_keys(int count)
+{
+	if (count > 0x8000)
+		count = 0x8000;
+	while (count > 0xffff / length + 1)
+		count >>= 1;
+
+	return count;
+}
+
+/*
+ * Memory needed for one buffer of count keys.
+ */
+static size_t single_buffer_size(int count)
+{
+	return sizeof(struct db_keys) - 1 + (size_t)length * count +
+		sizeof(struct db_keys_hash) +
+		sizeof(struct db_keys_hash_entry) * (count - 1);
+}
+
+static int single_order_cmp(const void *a, const void *b)
+{
+	const struct single_order *x = a, *y = b;
+
+	return x->salt->sequential_id - y->salt->sequential_id;
+}
+
+static int single_rank_cmp(const void *a, const void *b)
+{
+	const struct single_order *x = a, *y = b;
+
+	return x->rank - y->rank;
+}
+
+static void single_init_order(void)
+{
+	struct db_salt *salt;
+	int index = 0;
+
+	order = mem_alloc(salt_total * sizeof(*order));
+	salt = single_db->salts;
+	do {
+		order[index].rank = index;
+		order[index++].salt = salt;
+	} while ((salt = salt->next));
+
+	qsort(order, salt_total, sizeof(*order), single_order_cmp);
+}
+
 static void single_init(void)
 {
 	struct db_salt *salt;
+	int max_buffer_size, max_count;
 
 	log_event("Proceeding with \"single crack\" mode");
 
@@ -106,14 +207,43 @@ static void single_init(void)
 	key_count = single_db->format->params.min_keys_per_crypt;
 	if (key_count < SINGLE_HASH_MIN)
 		key_count = SINGLE_HASH_MIN;
+	key_count = single_limit_keys(key_count);
+
 /*
- * We use "short" for buffered key indices and "unsigned short" for buffered
- * key offsets - make sure these don't overflow.
+ * With OpenMP, min_keys_per_crypt is typically just one thread's share of a
+ * crypt_all() call, so buffers of that size leave the other threads idle.
+ * Buffer max_keys_per_crypt keys per salt instead.  If that doesn't fit in
+ * SingleMaxBufferSize for all salts, do it for as many salts as fit at a time
+ * (at least one).  Keeping that window small enough to stay in cache matters
+ * more than its size, since adding a key touches the salt's buffer and hash.
  */
-	if (key_count > 0x8000)
-		key_count = 0x8000;
-	while (key_count > 0xffff / length + 1)
-		key_count >>= 1;
+	if ((max_buffer_size = cfg_get_int(SECTION_OPTIONS, NULL,
+	                                   "SingleMaxBufferSize")) < 0)
+		max_buffer_size = SINGLE_MAX_BUFFER_SIZE;
+	max_count = single_limit_keys(
+		single_db->format->params.max_keys_per_crypt);
+	window = NULL;
+	order = NULL;
+	window_count = window_start = window_end = restore_window = 0;
+	salt_total = single_db->salt_count;
+	if (max_count > key_count) {
+		size_t fit = ((size_t)max_buffer_size << 20) /
+			single_buffer_size(max_count);
+
+		if (fit > salt_total) {
+			key_count = max_count;
+		} else {
+			window_size = fit ? fit : 1;
+			window_key_count = max_count;
+			window = mem_alloc_tiny(window_size * sizeof(*window),
+			                        MEM_ALIGN_WORD);
+			window_keys = mem_calloc_tiny(window_size *
+			    sizeof(*window_keys), MEM_ALIGN_WORD);
+			window_saved = mem_alloc_tiny(window_size *
+			    sizeof(*window_saved), MEM_ALIGN_WORD);
+			single_init_order();
+		}
+	}
 
 	if (rpp_init(rule_ctx, pers_opts.activesinglerules)) {
 		log_event("! No \"%s\" mode rules found",
@@ -137,7 +267,7 @@ static void single_init(void)
 
 	salt = single_db->salts;
 	do {
-		single_alloc_keys(&salt->keys);
+		single_alloc_keys(&salt->keys, key_count);
 	} while ((salt = salt->next));
 
 	if (key_count > 1)
@@ -146,9 +276,12 @@ static void single_init(void)
 		single_db->salt_count != 1 ? "s" : "",
 		key_count,
 		single_db->salt_count != 1 ? " each" : "");
+	if (window)
+	log_event("- Processing %d salts at a time, with buffers of %d "
+		"candidate passwords", window_size, window_key_count);
 
 	guessed_keys = NULL;
-	single_alloc_keys(&guessed_keys);
+	single_alloc_keys(&guessed_keys, window ? window_key_count : key_count);
 
 	crk_init(single_db, NULL, guessed_keys);
 }
@@ -238,7 +371,7 @@ static int single_add_key(struct db_salt *salt, char *key, int is_from_guesses)
 
 	keys->count_from_guesses += is_from_guesses;
 
-	if (++(keys->count) >= key_count)
+	if (++(keys->count) >= keys->size)
 		return single_process_buffer(salt);
 
 	return 0;
@@ -403,7 +536,7 @@ next:
 		last = &pw->next;
 	} while ((pw = pw->next));
 
-	if (keys->count && rule_number - keys->rule > (key_count << 1))
+	if (keys->count && rule_number - keys->rule > (keys->size << 1))
 		if (single_process_buffer(salt))
 			return 1;
 
@@ -420,12 +553,26 @@ no_own_words:
 	return 0;
 }
 
-static void single_run(void)
+/* The salts we run rules over: those in the window, or else all of them */
+static MAYBE_INLINE struct db_salt *single_next_salt(struct db_salt *salt,
+	int *index)
+{
+	if (window)
+		return *index < window_count ? window[(*index)++].salt : NULL;
+
+	return salt ? salt->next : single_db->salts;
+}
+
+/*
+ * Run the rules over the current salts.  Returns non-zero if we're done with
+ * all salts, or zero if we ran out of rules or of words to apply them to.
+ */
+static int single_run_rules(void)
 {
 	char *prerule, *rule;
 	struct db_salt *salt;
 	int min, saved_min;
-	int have_words;
+	int have_words, index;
 
 	saved_min = rec_rule;
 	while ((prerule = rpp_next(rule_ctx))) {
@@ -467,19 +614,21 @@ static void single_run(void)
 		min = rule_number;
 
 		/* pot reload might have removed the salt */
-		if (!(salt = single_db->salts))
-			return;
-		do {
+		if (!single_db->salts)
+			return 1;
+		salt = NULL;
+		index = 0;
+		while ((salt = single_next_salt(salt, &index))) {
 			if (!salt->list)
 				continue;
 			if (single_process_salt(salt, rule))
-				return;
+				return 1;
 			if (!salt->keys->have_words)
 				continue;
 			have_words = 1;
 			if (salt->keys->rule < min)
 				min = salt->keys->rule;
-		} while ((salt = salt->next));
+		}
 
 		if (event_reload && single_db->salts)
 			crk_reload_pot();
@@ -490,10 +639,119 @@ static void single_run(void)
 		if (have_words)
 			continue;
 
+		if (!window)
 		log_event("- No information to base%s candidate passwords on",
 			rule_number > 1 ? " further" : "");
+		return 0;
+	}
+
+	return 0;
+}
+
+/*
+ * Move the next window_size salts into the window, trying what's left in
+ * their own buffers first, and give them full size buffers.  A restored
+ * session's first window only gets the salts that were in the interrupted
+ * one, as the rules already applied to those don't apply to any others.
+ */
+static int single_window_open(void)
+{
+	struct db_salt *salt;
+	int index;
+
+	window_start = window_end;
+	if (restore_window) {
+		while (window_start < salt_total &&
+		       order[window_start].salt->sequential_id < restore_start)
+			window_start++;
+	}
+
+	window_count = 0;
+	for (window_end = window_start; window_end < salt_total &&
+	    window_count < window_size; window_end++) {
+		if (restore_window == 2 &&
+		    order[window_end].salt->sequential_id >= restore_end)
+			break;
+		salt = order[window_end].salt;
+		if (!salt->list)
+			continue;
+		if (salt->keys->count && single_process_buffer(salt))
+			return 1;
+		if (!salt->list)
+			continue;
+
+		window[window_count++] = order[window_end];
+	}
+	restore_window = 0;
+
+	qsort(window, window_count, sizeof(*window), single_rank_cmp);
+	for (index = 0; index < window_count; index++) {
+		salt = window[index].salt;
+		window_saved[index] = salt->keys;
+		single_alloc_keys(&window_keys[index], window_key_count);
+		salt->keys = window_keys[index];
+	}
+
+	return 0;
+}
+
+/*
+ * Process what's left in the window's buffers, and give its salts back their
+ * small buffers, which from now on only get other salts' guesses.
+ */
+static int single_window_close(void)
+{
+	struct db_salt *salt;
+	int index;
+
+	for (index = 0; index < window_count; index++) {
+		salt = window[index].salt;
+		if (salt->list && salt->keys->count &&
+		    single_process_buffer(salt))
+			return 1;
+	}
+
+	for (index = 0; index < window_count; index++) {
+		salt = window[index].salt;
+		salt->keys = window_saved[index];
+		single_alloc_keys(&salt->keys, key_count);
+	}
+	window_count = 0;
+
+/*
+ * Try the guesses the other salts got from this window's cracks now, rather
+ * than leaving them in buffers that an interrupted session would lose.
+ */
+	if ((salt = single_db->salts))
+	do {
+		if (salt->list && salt->keys->count &&
+		    single_process_buffer(salt))
+			return 1;
+	} while ((salt = salt->next));
+
+	return 0;
+}
+
+static void single_run(void)
+{
+	if (!window) {
+		single_run_rules();
 		return;
 	}
+
+	while (window_end < salt_total && single_db->salts) {
+		if (single_window_open())
+			return;
+		if (window_count && single_run_rules())
+			return;
+		if (single_window_close())
+			return;
+
+		/* Start over with all rules for the next window */
+		rpp_init(rule_ctx, pers_opts.activesinglerules);
+		rec_rule = rule_number = 0;
+	}
+	window_start = window_end;
 }
 
 static void single_done(void)
@@ -518,6 +776,8 @@ static void single_done(void)
 	}
 
 	rec_done(event_abort || (status.pass && single_db->salts));
+
+	MEM_FREE(order);
 }
 
 void do_single_crack(struct db_main *db)
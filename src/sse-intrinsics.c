@@ -2260,3 +2260,249 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 
 }
 #endif
+
+/* RIPEMD-160 below */
+
+#if defined (MMX_COEF_RIPEMD160)
+#define RIPEMD160_F1(x,y,z) _mm_xor_si128 (_mm_xor_si128 (x, y), z)
+#define RIPEMD160_F2(x,y,z) _mm_cmov_si128 (y, z, x)
+#define RIPEMD160_F3(x,y,z) _mm_xor_si128 (_mm_or_si128 (x, _mm_xor_si128 (y, mask)), z)
+#define RIPEMD160_F4(x,y,z) _mm_cmov_si128 (x, y, z)
+#define RIPEMD160_F5(x,y,z) _mm_xor_si128 (x, _mm_or_si128 (y, _mm_xor_si128 (z, mask)))
+
+#define RIPEMD160_STEP0(f,a,b,c,d,e,x,s)               \
+{                                                    \
+    a = _mm_add_epi32 (a, f(b,c,d));                 \
+    a = _mm_add_epi32 (a, w[x]);                     \
+    a = _mm_add_epi32 (_mm_roti_epi32 (a, s), e);    \
+    c = _mm_roti_epi32 (c, 10);                      \
+}
+#define RIPEMD160_STEP(f,a,b,c,d,e,x,K,s)              \
+{                                                    \
+    a = _mm_add_epi32 (a, _mm_set1_epi32(K));        \
+    RIPEMD160_STEP0(f,a,b,c,d,e,x,s)                 \
+}
+
+/*
+ * Same buffer layouts as SSESHA256body (MMX_COEF_RIPEMD160 lanes, word w
+ * of lane j at [w*MMX_COEF_RIPEMD160+j], state likewise), but RIPEMD-160
+ * is little endian, so nothing is byte swapped on the way in or out.
+ * Supports SSEi_MIXED_IN, SSEi_FLAT_IN and SSEi_RELOAD.  With one lane
+ * group, OUTPUT_AS_INP_FMT and RELOAD_INP_FMT need no special handling.
+ */
+void SSERIPEMD160body(__m128i *data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags)
+{
+	__m128i a1, b1, c1, d1, e1, a2, b2, c2, d2, e2, h[5], mask;
+	union {
+		__m128i w[16];
+		ARCH_WORD_32 p[16*sizeof(__m128i)/sizeof(ARCH_WORD_32)];
+	}_w;
+	__m128i *w=_w.w;
+	int i;
+
+	if (SSEi_flags & SSEi_FLAT_IN) {
+		int j;
+		ARCH_WORD_32 *p = _w.p;
+		ARCH_WORD_32 *saved_key = (ARCH_WORD_32 *)data;
+
+		for (j=0; j < 16; j++)
+			for (i=0; i < MMX_COEF_RIPEMD160; i++)
+				*p++ = saved_key[(i<<4)+j];
+	} else
+		memcpy(w, data, 16*sizeof(__m128i));
+
+	if (SSEi_flags & SSEi_RELOAD) {
+		for (i=0; i < 5; i++)
+			h[i] = _mm_load_si128((__m128i *)&reload_state[i*4]);
+	} else {
+		h[0] = _mm_set1_epi32 (0x67452301);
+		h[1] = _mm_set1_epi32 (0xefcdab89);
+		h[2] = _mm_set1_epi32 (0x98badcfe);
+		h[3] = _mm_set1_epi32 (0x10325476);
+		h[4] = _mm_set1_epi32 (0xc3d2e1f0);
+	}
+	mask = _mm_set1_epi32(0xffffffff);
+
+	a1 = a2 = h[0];
+	b1 = b2 = h[1];
+	c1 = c2 = h[2];
+	d1 = d2 = h[3];
+	e1 = e2 = h[4];
+
+	RIPEMD160_STEP0(RIPEMD160_F1, a1,b1,c1,d1,e1,  0, 11);
+	RIPEMD160_STEP0(RIPEMD160_F1, e1,a1,b1,c1,d1,  1, 14);
+	RIPEMD160_STEP0(RIPEMD160_F1, d1,e1,a1,b1,c1,  2, 15);
+	RIPEMD160_STEP0(RIPEMD160_F1, c1,d1,e1,a1,b1,  3, 12);
+	RIPEMD160_STEP0(RIPEMD160_F1, b1,c1,d1,e1,a1,  4,  5);
+	RIPEMD160_STEP0(RIPEMD160_F1, a1,b1,c1,d1,e1,  5,  8);
+	RIPEMD160_STEP0(RIPEMD160_F1, e1,a1,b1,c1,d1,  6,  7);
+	RIPEMD160_STEP0(RIPEMD160_F1, d1,e1,a1,b1,c1,  7,  9);
+	RIPEMD160_STEP0(RIPEMD160_F1, c1,d1,e1,a1,b1,  8, 11);
+	RIPEMD160_STEP0(RIPEMD160_F1, b1,c1,d1,e1,a1,  9, 13);
+	RIPEMD160_STEP0(RIPEMD160_F1, a1,b1,c1,d1,e1, 10, 14);
+	RIPEMD160_STEP0(RIPEMD160_F1, e1,a1,b1,c1,d1, 11, 15);
+	RIPEMD160_STEP0(RIPEMD160_F1, d1,e1,a1,b1,c1, 12,  6);
+	RIPEMD160_STEP0(RIPEMD160_F1, c1,d1,e1,a1,b1, 13,  7);
+	RIPEMD160_STEP0(RIPEMD160_F1, b1,c1,d1,e1,a1, 14,  9);
+	RIPEMD160_STEP0(RIPEMD160_F1, a1,b1,c1,d1,e1, 15,  8);
+
+	RIPEMD160_STEP (RIPEMD160_F2, e1,a1,b1,c1,d1,  7, 0x5a827999,  7);
+	RIPEMD160_STEP (RIPEMD160_F2, d1,e1,a1,b1,c1,  4, 0x5a827999,  6);
+	RIPEMD160_STEP (RIPEMD160_F2, c1,d1,e1,a1,b1, 13, 0x5a827999,  8);
+	RIPEMD160_STEP (RIPEMD160_F2, b1,c1,d1,e1,a1,  1, 0x5a827999, 13);
+	RIPEMD160_STEP (RIPEMD160_F2, a1,b1,c1,d1,e1, 10, 0x5a827999, 11);
+	RIPEMD160_STEP (RIPEMD160_F2, e1,a1,b1,c1,d1,  6, 0x5a827999,  9);
+	RIPEMD160_STEP (RIPEMD160_F2, d1,e1,a1,b1,c1, 15, 0x5a827999,  7);
+	RIPEMD160_STEP (RIPEMD160_F2, c1,d1,e1,a1,b1,  3, 0x5a827999, 15);
+	RIPEMD160_STEP (RIPEMD160_F2, b1,c1,d1,e1,a1, 12, 0x5a827999,  7);
+	RIPEMD160_STEP (RIPEMD160_F2, a1,b1,c1,d1,e1,  0, 0x5a827999, 12);
+	RIPEMD160_STEP (RIPEMD160_F2, e1,a1,b1,c1,d1,  9, 0x5a827999, 15);
+	RIPEMD160_STEP (RIPEMD160_F2, d1,e1,a1,b1,c1,  5, 0x5a827999,  9);
+	RIPEMD160_STEP (RIPEMD160_F2, c1,d1,e1,a1,b1,  2, 0x5a827999, 11);
+	RIPEMD160_STEP (RIPEMD160_F2, b1,c1,d1,e1,a1, 14, 0x5a827999,  7);
+	RIPEMD160_STEP (RIPEMD160_F2, a1,b1,c1,d1,e1, 11, 0x5a827999, 13);
+	RIPEMD160_STEP (RIPEMD160_F2, e1,a1,b1,c1,d1,  8, 0x5a827999, 12);
+
+	RIPEMD160_STEP (RIPEMD160_F3, d1,e1,a1,b1,c1,  3, 0x6ed9eba1, 11);
+	RIPEMD160_STEP (RIPEMD160_F3, c1,d1,e1,a1,b1, 10, 0x6ed9eba1, 13);
+	RIPEMD160_STEP (RIPEMD160_F3, b1,c1,d1,e1,a1, 14, 0x6ed9eba1,  6);
+	RIPEMD160_STEP (RIPEMD160_F3, a1,b1,c1,d1,e1,  4, 0x6ed9eba1,  7);
+	RIPEMD160_STEP (RIPEMD160_F3, e1,a1,b1,c1,d1,  9, 0x6ed9eba1, 14);
+	RIPEMD160_STEP (RIPEMD160_F3, d1,e1,a1,b1,c1, 15, 0x6ed9eba1,  9);
+	RIPEMD160_STEP (RIPEMD160_F3, c1,d1,e1,a1,b1,  8, 0x6ed9eba1, 13);
+	RIPEMD160_STEP (RIPEMD160_F3, b1,c1,d1,e1,a1,  1, 0x6ed9eba1, 15);
+	RIPEMD160_STEP (RIPEMD160_F3, a1,b1,c1,d1,e1,  2, 0x6ed9eba1, 14);
+	RIPEMD160_STEP (RIPEMD160_F3, e1,a1,b1,c1,d1,  7, 0x6ed9eba1,  8);
+	RIPEMD160_STEP (RIPEMD160_F3, d1,e1,a1,b1,c1,  0, 0x6ed9eba1, 13);
+	RIPEMD160_STEP (RIPEMD160_F3, c1,d1,e1,a1,b1,  6, 0x6ed9eba1,  6);
+	RIPEMD160_STEP (RIPEMD160_F3, b1,c1,d1,e1,a1, 13, 0x6ed9eba1,  5);
+	RIPEMD160_STEP (RIPEMD160_F3, a1,b1,c1,d1,e1, 11, 0x6ed9eba1, 12);
+	RIPEMD160_STEP (RIPEMD160_F3, e1,a1,b1,c1,d1,  5, 0x6ed9eba1,  7);
+	RIPEMD160_STEP (RIPEMD160_F3, d1,e1,a1,b1,c1, 12, 0x6ed9eba1,  5);
+
+	RIPEMD160_STEP (RIPEMD160_F4, c1,d1,e1,a1,b1,  1, 0x8f1bbcdc, 11);
+	RIPEMD160_STEP (RIPEMD160_F4, b1,c1,d1,e1,a1,  9, 0x8f1bbcdc, 12);
+	RIPEMD160_STEP (RIPEMD160_F4, a1,b1,c1,d1,e1, 11, 0x8f1bbcdc, 14);
+	RIPEMD160_STEP (RIPEMD160_F4, e1,a1,b1,c1,d1, 10, 0x8f1bbcdc, 15);
+	RIPEMD160_STEP (RIPEMD160_F4, d1,e1,a1,b1,c1,  0, 0x8f1bbcdc, 14);
+	RIPEMD160_STEP (RIPEMD160_F4, c1,d1,e1,a1,b1,  8, 0x8f1bbcdc, 15);
+	RIPEMD160_STEP (RIPEMD160_F4, b1,c1,d1,e1,a1, 12, 0x8f1bbcdc,  9);
+	RIPEMD160_STEP (RIPEMD160_F4, a1,b1,c1,d1,e1,  4, 0x8f1bbcdc,  8);
+	RIPEMD160_STEP (RIPEMD160_F4, e1,a1,b1,c1,d1, 13, 0x8f1bbcdc,  9);
+	RIPEMD160_STEP (RIPEMD160_F4, d1,e1,a1,b1,c1,  3, 0x8f1bbcdc, 14);
+	RIPEMD160_STEP (RIPEMD160_F4, c1,d1,e1,a1,b1,  7, 0x8f1bbcdc,  5);
+	RIPEMD160_STEP (RIPEMD160_F4, b1,c1,d1,e1,a1, 15, 0x8f1bbcdc,  6);
+	RIPEMD160_STEP (RIPEMD160_F4, a1,b1,c1,d1,e1, 14, 0x8f1bbcdc,  8);
+	RIPEMD160_STEP (RIPEMD160_F4, e1,a1,b1,c1,d1,  5, 0x8f1bbcdc,  6);
+	RIPEMD160_STEP (RIPEMD160_F4, d1,e1,a1,b1,c1,  6, 0x8f1bbcdc,  5);
+	RIPEMD160_STEP (RIPEMD160_F4, c1,d1,e1,a1,b1,  2, 0x8f1bbcdc, 12);
+
+	RIPEMD160_STEP (RIPEMD160_F5, b1,c1,d1,e1,a1,  4, 0xa953fd4e,  9);
+	RIPEMD160_STEP (RIPEMD160_F5, a1,b1,c1,d1,e1,  0, 0xa953fd4e, 15);
+	RIPEMD160_STEP (RIPEMD160_F5, e1,a1,b1,c1,d1,  5, 0xa953fd4e,  5);
+	RIPEMD160_STEP (RIPEMD160_F5, d1,e1,a1,b1,c1,  9, 0xa953fd4e, 11);
+	RIPEMD160_STEP (RIPEMD160_F5, c1,d1,e1,a1,b1,  7, 0xa953fd4e,  6);
+	RIPEMD160_STEP (RIPEMD160_F5, b1,c1,d1,e1,a1, 12, 0xa953fd4e,  8);
+	RIPEMD160_STEP (RIPEMD160_F5, a1,b1,c1,d1,e1,  2, 0xa953fd4e, 13);
+	RIPEMD160_STEP (RIPEMD160_F5, e1,a1,b1,c1,d1, 10, 0xa953fd4e, 12);
+	RIPEMD160_STEP (RIPEMD160_F5, d1,e1,a1,b1,c1, 14, 0xa953fd4e,  5);
+	RIPEMD160_STEP (RIPEMD160_F5, c1,d1,e1,a1,b1,  1, 0xa953fd4e, 12);
+	RIPEMD160_STEP (RIPEMD160_F5, b1,c1,d1,e1,a1,  3, 0xa953fd4e, 13);
+	RIPEMD160_STEP (RIPEMD160_F5, a1,b1,c1,d1,e1,  8, 0xa953fd4e, 14);
+	RIPEMD160_STEP (RIPEMD160_F5, e1,a1,b1,c1,d1, 11, 0xa953fd4e, 11);
+	RIPEMD160_STEP (RIPEMD160_F5, d1,e1,a1,b1,c1,  6, 0xa953fd4e,  8);
+	RIPEMD160_STEP (RIPEMD160_F5, c1,d1,e1,a1,b1, 15, 0xa953fd4e,  5);
+	RIPEMD160_STEP (RIPEMD160_F5, b1,c1,d1,e1,a1, 13, 0xa953fd4e,  6);
+	RIPEMD160_STEP (RIPEMD160_F5, a2,b2,c2,d2,e2,  5, 0x50a28be6,  8);
+	RIPEMD160_STEP (RIPEMD160_F5, e2,a2,b2,c2,d2, 14, 0x50a28be6,  9);
+	RIPEMD160_STEP (RIPEMD160_F5, d2,e2,a2,b2,c2,  7, 0x50a28be6,  9);
+	RIPEMD160_STEP (RIPEMD160_F5, c2,d2,e2,a2,b2,  0, 0x50a28be6, 11);
+	RIPEMD160_STEP (RIPEMD160_F5, b2,c2,d2,e2,a2,  9, 0x50a28be6, 13);
+	RIPEMD160_STEP (RIPEMD160_F5, a2,b2,c2,d2,e2,  2, 0x50a28be6, 15);
+	RIPEMD160_STEP (RIPEMD160_F5, e2,a2,b2,c2,d2, 11, 0x50a28be6, 15);
+	RIPEMD160_STEP (RIPEMD160_F5, d2,e2,a2,b2,c2,  4, 0x50a28be6,  5);
+	RIPEMD160_STEP (RIPEMD160_F5, c2,d2,e2,a2,b2, 13, 0x50a28be6,  7);
+	RIPEMD160_STEP (RIPEMD160_F5, b2,c2,d2,e2,a2,  6, 0x50a28be6,  7);
+	RIPEMD160_STEP (RIPEMD160_F5, a2,b2,c2,d2,e2, 15, 0x50a28be6,  8);
+	RIPEMD160_STEP (RIPEMD160_F5, e2,a2,b2,c2,d2,  8, 0x50a28be6, 11);
+	RIPEMD160_STEP (RIPEMD160_F5, d2,e2,a2,b2,c2,  1, 0x50a28be6, 14);
+	RIPEMD160_STEP (RIPEMD160_F5, c2,d2,e2,a2,b2, 10, 0x50a28be6, 14);
+	RIPEMD160_STEP (RIPEMD160_F5, b2,c2,d2,e2,a2,  3, 0x50a28be6, 12);
+	RIPEMD160_STEP (RIPEMD160_F5, a2,b2,c2,d2,e2, 12, 0x50a28be6,  6);
+
+	RIPEMD160_STEP (RIPEMD160_F4, e2,a2,b2,c2,d2,  6, 0x5c4dd124,  9);
+	RIPEMD160_STEP (RIPEMD160_F4, d2,e2,a2,b2,c2, 11, 0x5c4dd124, 13);
+	RIPEMD160_STEP (RIPEMD160_F4, c2,d2,e2,a2,b2,  3, 0x5c4dd124, 15);
+	RIPEMD160_STEP (RIPEMD160_F4, b2,c2,d2,e2,a2,  7, 0x5c4dd124,  7);
+	RIPEMD160_STEP (RIPEMD160_F4, a2,b2,c2,d2,e2,  0, 0x5c4dd124, 12);
+	RIPEMD160_STEP (RIPEMD160_F4, e2,a2,b2,c2,d2, 13, 0x5c4dd124,  8);
+	RIPEMD160_STEP (RIPEMD160_F4, d2,e2,a2,b2,c2,  5, 0x5c4dd124,  9);
+	RIPEMD160_STEP (RIPEMD160_F4, c2,d2,e2,a2,b2, 10, 0x5c4dd124, 11);
+	RIPEMD160_STEP (RIPEMD160_F4, b2,c2,d2,e2,a2, 14, 0x5c4dd124,  7);
+	RIPEMD160_STEP (RIPEMD160_F4, a2,b2,c2,d2,e2, 15, 0x5c4dd124,  7);
+	RIPEMD160_STEP (RIPEMD160_F4, e2,a2,b2,c2,d2,  8, 0x5c4dd124, 12);
+	RIPEMD160_STEP (RIPEMD160_F4, d2,e2,a2,b2,c2, 12, 0x5c4dd124,  7);
+	RIPEMD160_STEP (RIPEMD160_F4, c2,d2,e2,a2,b2,  4, 0x5c4dd124,  6);
+	RIPEMD160_STEP (RIPEMD160_F4, b2,c2,d2,e2,a2,  9, 0x5c4dd124, 15);
+	RIPEMD160_STEP (RIPEMD160_F4, a2,b2,c2,d2,e2,  1, 0x5c4dd124, 13);
+	RIPEMD160_STEP (RIPEMD160_F4, e2,a2,b2,c2,d2,  2, 0x5c4dd124, 11);
+
+	RIPEMD160_STEP (RIPEMD160_F3, d2,e2,a2,b2,c2, 15, 0x6d703ef3,  9);
+	RIPEMD160_STEP (RIPEMD160_F3, c2,d2,e2,a2,b2,  5, 0x6d703ef3,  7);
+	RIPEMD160_STEP (RIPEMD160_F3, b2,c2,d2,e2,a2,  1, 0x6d703ef3, 15);
+	RIPEMD160_STEP (RIPEMD160_F3, a2,b2,c2,d2,e2,  3, 0x6d703ef3, 11);
+	RIPEMD160_STEP (RIPEMD160_F3, e2,a2,b2,c2,d2,  7, 0x6d703ef3,  8);
+	RIPEMD160_STEP (RIPEMD160_F3, d2,e2,a2,b2,c2, 14, 0x6d703ef3,  6);
+	RIPEMD160_STEP (RIPEMD160_F3, c2,d2,e2,a2,b2,  6, 0x6d703ef3,  6);
+	RIPEMD160_STEP (RIPEMD160_F3, b2,c2,d2,e2,a2,  9, 0x6d703ef3, 14);
+	RIPEMD160_STEP (RIPEMD160_F3, a2,b2,c2,d2,e2, 11, 0x6d703ef3, 12);
+	RIPEMD160_STEP (RIPEMD160_F3, e2,a2,b2,c2,d2,  8, 0x6d703ef3, 13);
+	RIPEMD160_STEP (RIPEMD160_F3, d2,e2,a2,b2,c2, 12, 0x6d703ef3,  5);
+	RIPEMD160_STEP (RIPEMD160_F3, c2,d2,e2,a2,b2,  2, 0x6d703ef3, 14);
+	RIPEMD160_STEP (RIPEMD160_F3, b2,c2,d2,e2,a2, 10, 0x6d703ef3, 13);
+	RIPEMD160_STEP (RIPEMD160_F3, a2,b2,c2,d2,e2,  0, 0x6d703ef3, 13);
+	RIPEMD160_STEP (RIPEMD160_F3, e2,a2,b2,c2,d2,  4, 0x6d703ef3,  7);
+	RIPEMD160_STEP (RIPEMD160_F3, d2,e2,a2,b2,c2, 13, 0x6d703ef3,  5);
+
+	RIPEMD160_STEP (RIPEMD160_F2, c2,d2,e2,a2,b2,  8, 0x7a6d76e9, 15);
+	RIPEMD160_STEP (RIPEMD160_F2, b2,c2,d2,e2,a2,  6, 0x7a6d76e9,  5);
+	RIPEMD160_STEP (RIPEMD160_F2, a2,b2,c2,d2,e2,  4, 0x7a6d76e9,  8);
+	RIPEMD160_STEP (RIPEMD160_F2, e2,a2,b2,c2,d2,  1, 0x7a6d76e9, 11);
+	RIPEMD160_STEP (RIPEMD160_F2, d2,e2,a2,b2,c2,  3, 0x7a6d76e9, 14);
+	RIPEMD160_STEP (RIPEMD160_F2, c2,d2,e2,a2,b2, 11, 0x7a6d76e9, 14);
+	RIPEMD160_STEP (RIPEMD160_F2, b2,c2,d2,e2,a2, 15, 0x7a6d76e9,  6);
+	RIPEMD160_STEP (RIPEMD160_F2, a2,b2,c2,d2,e2,  0, 0x7a6d76e9, 14);
+	RIPEMD160_STEP (RIPEMD160_F2, e2,a2,b2,c2,d2,  5, 0x7a6d76e9,  6);
+	RIPEMD160_STEP (RIPEMD160_F2, d2,e2,a2,b2,c2, 12, 0x7a6d76e9,  9);
+	RIPEMD160_STEP (RIPEMD160_F2, c2,d2,e2,a2,b2,  2, 0x7a6d76e9, 12);
+	RIPEMD160_STEP (RIPEMD160_F2, b2,c2,d2,e2,a2, 13, 0x7a6d76e9,  9);
+	RIPEMD160_STEP (RIPEMD160_F2, a2,b2,c2,d2,e2,  9, 0x7a6d76e9, 12);
+	RIPEMD160_STEP (RIPEMD160_F2, e2,a2,b2,c2,d2,  7, 0x7a6d76e9,  5);
+	RIPEMD160_STEP (RIPEMD160_F2, d2,e2,a2,b2,c2, 10, 0x7a6d76e9, 15);
+	RIPEMD160_STEP (RIPEMD160_F2, c2,d2,e2,a2,b2, 14, 0x7a6d76e9,  8);
+
+	RIPEMD160_STEP0(RIPEMD160_F1, b2,c2,d2,e2,a2, 12,  8);
+	RIPEMD160_STEP0(RIPEMD160_F1, a2,b2,c2,d2,e2, 15,  5);
+	RIPEMD160_STEP0(RIPEMD160_F1, e2,a2,b2,c2,d2, 10, 12);
+	RIPEMD160_STEP0(RIPEMD160_F1, d2,e2,a2,b2,c2,  4,  9);
+	RIPEMD160_STEP0(RIPEMD160_F1, c2,d2,e2,a2,b2,  1, 12);
+	RIPEMD160_STEP0(RIPEMD160_F1, b2,c2,d2,e2,a2,  5,  5);
+	RIPEMD160_STEP0(RIPEMD160_F1, a2,b2,c2,d2,e2,  8, 14);
+	RIPEMD160_STEP0(RIPEMD160_F1, e2,a2,b2,c2,d2,  7,  6);
+	RIPEMD160_STEP0(RIPEMD160_F1, d2,e2,a2,b2,c2,  6,  8);
+	RIPEMD160_STEP0(RIPEMD160_F1, c2,d2,e2,a2,b2,  2, 13);
+	RIPEMD160_STEP0(RIPEMD160_F1, b2,c2,d2,e2,a2, 13,  6);
+	RIPEMD160_STEP0(RIPEMD160_F1, a2,b2,c2,d2,e2, 14,  5);
+	RIPEMD160_STEP0(RIPEMD160_F1, e2,a2,b2,c2,d2,  0, 15);
+	RIPEMD160_STEP0(RIPEMD160_F1, d2,e2,a2,b2,c2,  3, 13);
+	RIPEMD160_STEP0(RIPEMD160_F1, c2,d2,e2,a2,b2,  9, 11);
+	RIPEMD160_STEP0(RIPEMD160_F1, b2,c2,d2,e2,a2, 11, 11);
+
+	d2 = _mm_add_epi32 (_mm_add_epi32 (h[1], c1), d2);
+	_mm_store_si128 ((__m128i *)&out[4],  _mm_add_epi32 (_mm_add_epi32 (h[2], d1), e2));
+	_mm_store_si128 ((__m128i *)&out[8],  _mm_add_epi32 (_mm_add_epi32 (h[3], e1), a2));
+	_mm_store_si128 ((__m128i *)&out[12], _mm_add_epi32 (_mm_add_epi32 (h[4], a1), b2));
+	_mm_store_si128 ((__m128i *)&out[16], _mm_add_epi32 (_mm_add_epi32 (h[0], b1), c2));
+	_mm_store_si128 ((__m128i *)&out[0],  d2);
+}
+#endif
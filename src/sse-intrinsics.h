@@ -83,7 +83,7 @@ void SSESHA1body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, u
 #define SIMD_TYPE                 "SSE2"
 #endif
 
-// we use the 'outter' MMX_COEF wrapper, as the flag for SHA256/SHA512.  FIX_ME!!
+// we use the 'outter' MMX_COEF wrapper, as the flag for SHA256/SHA512/RIPEMD160.  FIX_ME!!
 #if MMX_COEF==4
 
 #ifdef MMX_COEF_SHA256
@@ -101,6 +101,12 @@ void SSESHA512body(__m128i* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 #define SHA512_SSE_PARA 1
 #endif
 
+#ifdef MMX_COEF_RIPEMD160
+#define RIPEMD160_ALGORITHM_NAME	"128/128 " SIMD_TYPE " " STRINGIZE(MMX_COEF_RIPEMD160)"x"
+void SSERIPEMD160body(__m128i* data, ARCH_WORD_32 *out, ARCH_WORD_32 *reload_state, unsigned SSEi_flags);
+#define RIPEMD160_BUF_SIZ 16
+#endif
+
 #endif
 
 #endif // __JTR_SSE_INTRINSICS_H__
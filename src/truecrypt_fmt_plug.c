@@ -17,8 +17,8 @@
  * Updated in Dec, 2014 by JimF.  This is a ugly format, and was converted
  * into a more standard (using crypt_all) format.  The PKCS5_PBKDF2_HMAC can
  * be replaced with faster pbkdf2_xxxx functions (possibly with SIMD usage).
- * this has been done for sha512.  ripemd160  and Whirlpool pbkdf2 header
- * files have been created.  Also, proper decrypt is now done, (in cmp_exact)
+ * this has been done for sha512 and ripemd160.  A Whirlpool pbkdf2 header
+ * file has been created.  Also, proper decrypt is now done, (in cmp_exact)
  * and we test against the 'TRUE' signature, and against 2 crc32's which
  * are computed over the 448 bytes of decrypted data.  So we now have a
  * full 96 bits of hash.  There will be no way we get false positives from
@@ -70,6 +70,15 @@ john_register_one(&fmt_truecrypt_whirlpool);
 #define MIN_KEYS_PER_CRYPT	1
 #define MAX_KEYS_PER_CRYPT	1
 
+/* tc_aes_xts must hand full groups to each of the SIMD PBKDF2 kernels */
+#if SSE_GROUP_SZ_RIPEMD160 > SSE_GROUP_SZ_SHA512
+#define XTS_KEYS_PER_CRYPT	SSE_GROUP_SZ_RIPEMD160
+#elif SSE_GROUP_SZ_SHA512
+#define XTS_KEYS_PER_CRYPT	SSE_GROUP_SZ_SHA512
+#else
+#define XTS_KEYS_PER_CRYPT	MAX_KEYS_PER_CRYPT
+#endif
+
 static unsigned char (*key_buffer)[PLAINTEXT_LENGTH + 1];
 static unsigned char (*first_block_dec)[16];
 
@@ -215,6 +224,9 @@ static void* get_salt(char *ciphertext)
 		ciphertext += TAG_RIPEMD160_LEN;
 		s->hash_type = IS_RIPEMD160;
 		s->num_iterations = 2000;
+#if SSE_GROUP_SZ_RIPEMD160
+		s->loop_inc = SSE_GROUP_SZ_RIPEMD160;
+#endif
 	} else {
 		// should never get here!  valid() should catch all lines that do not have the tags.
 		fprintf(stderr, "Error, unknown type in truecrypt::get_salt(), [%s]\n", ciphertext);
@@ -294,28 +306,34 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		unsigned char key[64];
 		int j;
 
+#if SSE_GROUP_SZ_SHA512 || SSE_GROUP_SZ_RIPEMD160
+		unsigned char Keys[XTS_KEYS_PER_CRYPT][64];
+		int lens[XTS_KEYS_PER_CRYPT];
+		unsigned char *pin[XTS_KEYS_PER_CRYPT];
+		union {
+			unsigned char *pout[XTS_KEYS_PER_CRYPT];
+			unsigned char *poutc;
+		} x;
+		for (j = 0; j < psalt->loop_inc; ++j) {
+			lens[j] = strlen((char*)(key_buffer[i+j]));
+			pin[j] = key_buffer[i+j];
+			x.pout[j] = Keys[j];
+		}
+#endif
 #if SSE_GROUP_SZ_SHA512
-		unsigned char Keys[SSE_GROUP_SZ_SHA512][64];
-		if (psalt->hash_type == IS_SHA512) {
-			int lens[SSE_GROUP_SZ_SHA512];
-			unsigned char *pin[SSE_GROUP_SZ_SHA512];
-			union {
-				unsigned char *pout[SSE_GROUP_SZ_SHA512];
-				unsigned char *poutc;
-			} x;
-			for (j = 0; j < SSE_GROUP_SZ_SHA512; ++j) {
-				lens[j] = strlen((char*)(key_buffer[i+j]));
-				pin[j] = key_buffer[i+j];
-				x.pout[j] = Keys[j];
-			}
+		if (psalt->hash_type == IS_SHA512)
 			pbkdf2_sha512_sse((const unsigned char **)pin, lens, psalt->salt, 64, psalt->num_iterations, &(x.poutc), sizeof(key), 0);
-		}
 #else
 		if (psalt->hash_type == IS_SHA512)
 			pbkdf2_sha512((const unsigned char*)key_buffer[i], strlen((char*)key_buffer[i]), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
 #endif
+#if SSE_GROUP_SZ_RIPEMD160
+		else if (psalt->hash_type == IS_RIPEMD160)
+			pbkdf2_ripemd160_sse((const unsigned char **)pin, lens, psalt->salt, 64, psalt->num_iterations, &(x.poutc), sizeof(key), 0);
+#else
 		else if (psalt->hash_type == IS_RIPEMD160)
 			pbkdf2_ripemd160(key_buffer[i], strlen((char*)(key_buffer[i])), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
+#endif
 		else
 			pbkdf2_whirlpool(key_buffer[i], strlen((char*)(key_buffer[i])), psalt->salt, 64, psalt->num_iterations, key, sizeof(key), 0);
 #if ARCH_LITTLE_ENDIAN==0
@@ -334,8 +352,8 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		}
 #endif
 		for (j = 0; j < psalt->loop_inc; ++j) {
-#if SSE_GROUP_SZ_SHA512
-			if (psalt->hash_type == IS_SHA512)
+#if SSE_GROUP_SZ_SHA512 || SSE_GROUP_SZ_RIPEMD160
+			if (psalt->loop_inc > 1)
 				memcpy(key, Keys[j], sizeof(key));
 #endif
 			// Try to decrypt using AES
@@ -497,13 +515,8 @@ struct fmt_main fmt_truecrypt = {
 		BINARY_ALIGN,
 		SALT_SIZE,
 		SALT_ALIGN,
-#if SSE_GROUP_SZ_SHA512
-		SSE_GROUP_SZ_SHA512,
-		SSE_GROUP_SZ_SHA512,
-#else
-		MIN_KEYS_PER_CRYPT,
-		MAX_KEYS_PER_CRYPT,
-#endif
+		XTS_KEYS_PER_CRYPT,
+		XTS_KEYS_PER_CRYPT,
 		FMT_CASE | FMT_8_BIT | FMT_OMP,
 #if FMT_MAIN_VERSION > 11
 		{
@@ -549,7 +562,11 @@ struct fmt_main fmt_truecrypt_ripemd160 = {
 	{
 		"tc_ripemd160",                   // FORMAT_LABEL
 		"TrueCrypt RIPEMD160 AES256_XTS", // FORMAT_NAME
+#if SSE_GROUP_SZ_RIPEMD160
+		RIPEMD160_ALGORITHM_NAME,         // ALGORITHM_NAME,
+#else
 		"32/" ARCH_BITS_STR,              // ALGORITHM_NAME,
+#endif
 		"",                               // BENCHMARK_COMMENT
 		-1,                               // BENCHMARK_LENGTH
 		0,
@@ -558,8 +575,13 @@ struct fmt_main fmt_truecrypt_ripemd160 = {
 		BINARY_ALIGN,
 		SALT_SIZE,
 		SALT_ALIGN,
+#if SSE_GROUP_SZ_RIPEMD160
+		SSE_GROUP_SZ_RIPEMD160,
+		SSE_GROUP_SZ_RIPEMD160,
+#else
 		MIN_KEYS_PER_CRYPT,
 		MAX_KEYS_PER_CRYPT,
+#endif
 		FMT_CASE | FMT_8_BIT | FMT_OMP,
 #if FMT_MAIN_VERSION > 11
 		{ NULL },
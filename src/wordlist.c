@@ -60,6 +60,21 @@
 #ifdef __SSE2__
 #include <emmintrin.h>
 #endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#if !AC_BUILT || HAVE_LIBZ
+#define WL_GZIP 1
+#include <zlib.h>
+#endif
+#if AC_BUILT && HAVE_PTHREAD
+#define WL_READ_THREAD 1
+#include <pthread.h>
+#include <signal.h>
+#endif
+#if WL_GZIP || WL_READ_THREAD
+#define WL_READ_AHEAD 1
+#endif
 #include "arch.h"
 #include "jumbo.h"
 #include "misc.h"
@@ -108,6 +123,45 @@ static char *mem_map, *map_pos, *map_end, *map_scan_end;
 static char *word_file_str, **words;
 static int64_t nWordFileLines;
 
+#if WL_READ_AHEAD
+/*
+ * Read-ahead wordlist. A compressed file, or a plain file or pipe we can't
+ * map, is read (by a background thread, if we have pthreads) into a ring of
+ * blocks that always end on a line boundary, and mgetl() is pointed at one
+ * block at a time. Positions (for restore) are offsets into the uncompressed
+ * stream.
+ */
+#define RA_BLOCK_SIZE		0x100000
+#define RA_RING_BLOCKS		4
+
+struct ra_block {
+	char *data;		/* RA_BLOCK_SIZE plus slack for mgetl() */
+	size_t len;		/* 0 means end of stream */
+	int64_t start;		/* uncompressed offset of data[0] */
+	int64_t in_pos;		/* input bytes consumed so far */
+	int error;		/* errno, or -1 for a zlib error */
+};
+
+static int ra_active, ra_fd = -1;
+#if WL_GZIP
+static gzFile gz_file;
+#endif
+static int64_t ra_file_len;
+static struct ra_block ra_ring[RA_RING_BLOCKS], *ra_cur;
+static char *ra_carry;
+static size_t ra_carry_len;
+static int64_t ra_out_pos;
+static unsigned int ra_head, ra_tail;
+static int ra_done;
+#if WL_READ_THREAD
+static int ra_running, ra_finished, ra_detached;
+static pthread_t ra_thread;
+static pthread_mutex_t ra_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ra_cond = PTHREAD_COND_INITIALIZER;
+static volatile int ra_stop;
+#endif
+#endif
+
 static void save_state(FILE *file)
 {
 	fprintf(file, "%d\n" LLd "\n" LLd "\n",
@@ -242,6 +296,555 @@ static MAYBE_INLINE char *mgetl(char *res)
 	return res;
 }
 
+#if WL_READ_AHEAD
+static int ra_read(char *buf, int len)
+{
+#if WL_GZIP
+	if (gz_file)
+		return gzread(gz_file, buf, len);
+#endif
+	return read(ra_fd, buf, len);
+}
+
+/* Fill the next block, carrying over any trailing partial line. */
+static void ra_fill(struct ra_block *b)
+{
+	int n = 0, len = ra_carry_len;
+
+	b->start = ra_out_pos;
+	b->error = 0;
+	memcpy(b->data, ra_carry, ra_carry_len);
+	ra_carry_len = 0;
+
+	while (len < RA_BLOCK_SIZE) {
+#if WL_READ_THREAD
+		/* Don't read any more once we're told to stop */
+		if (ra_stop)
+			break;
+#endif
+		if ((n = ra_read(b->data + len, RA_BLOCK_SIZE - len)) <= 0)
+			break;
+		len += n;
+		/* Don't sit on complete lines waiting for a slow pipe */
+		if (ra_fd >= 0 && memchr(b->data + len - n, '\n', n))
+			break;
+	}
+	if (n < 0)
+		b->error = ra_fd >= 0 ? errno : -1;
+#if WL_GZIP
+	else if (gz_file && len < RA_BLOCK_SIZE) {
+		int err;
+
+		/* A truncated file is an error, not just EOF */
+		gzerror(gz_file, &err);
+		if (err != Z_OK)
+			b->error = -1;
+	}
+#endif
+
+	if (n > 0) {
+		char *p = b->data + len;
+
+		while (p > b->data && p[-1] != '\n')
+			p--;
+		/* A line longer than the block is simply split */
+		if (p > b->data) {
+			ra_carry_len = b->data + len - p;
+			memcpy(ra_carry, p, ra_carry_len);
+			len = p - b->data;
+		}
+	}
+
+	memset(b->data + len, 0, 16);
+	b->len = len;
+	ra_out_pos += len;
+#if WL_GZIP
+	if (gz_file)
+		b->in_pos = gzoffset(gz_file);
+	else
+#endif
+		b->in_pos = ra_out_pos + ra_carry_len;
+}
+
+#if WL_READ_THREAD
+static void *ra_producer(void *arg)
+{
+	sigset_t set;
+
+	/* Leave all signal handling to the main thread */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	pthread_mutex_lock(&ra_mutex);
+	while (!ra_stop) {
+		struct ra_block *b;
+
+		if (ra_head - ra_tail >= RA_RING_BLOCKS) {
+			pthread_cond_wait(&ra_cond, &ra_mutex);
+			continue;
+		}
+		b = &ra_ring[ra_head % RA_RING_BLOCKS];
+		pthread_mutex_unlock(&ra_mutex);
+
+		ra_fill(b);
+
+		pthread_mutex_lock(&ra_mutex);
+		if (ra_stop)
+			break;
+		ra_head++;
+		pthread_cond_broadcast(&ra_cond);
+		if (!b->len || b->error)
+			break;
+	}
+	ra_finished = 1;
+	/* Nobody else will free the buffers of a reader we've let go */
+	if (ra_detached) {
+		int i;
+
+		for (i = 0; i < RA_RING_BLOCKS; i++)
+			MEM_FREE(ra_ring[i].data);
+		MEM_FREE(ra_carry);
+		ra_detached = 0;
+	}
+	pthread_mutex_unlock(&ra_mutex);
+
+	return NULL;
+}
+#endif
+
+/* Start reading at the current position of the input, known to be pos. */
+static void ra_start(int64_t pos)
+{
+	ra_head = ra_tail = 0;
+	ra_cur = NULL;
+	ra_carry_len = 0;
+	ra_out_pos = pos;
+	ra_done = 0;
+	map_pos = map_end = map_scan_end = NULL;
+#if WL_READ_THREAD
+	ra_stop = ra_finished = 0;
+	if (pthread_create(&ra_thread, NULL, ra_producer, NULL))
+		pexit("pthread_create");
+	ra_running = 1;
+#endif
+}
+
+static void ra_stop_thread(void)
+{
+#if WL_READ_THREAD
+	if (!ra_running)
+		return;
+	pthread_mutex_lock(&ra_mutex);
+	ra_stop = 1;
+	pthread_cond_broadcast(&ra_cond);
+	pthread_mutex_unlock(&ra_mutex);
+	pthread_join(ra_thread, NULL);
+	ra_running = 0;
+#endif
+}
+
+/* Hand the current block back and point mgetl() at the next one. */
+static int ra_next_block(void)
+{
+	if (ra_done)
+		return 0;
+
+#if WL_READ_THREAD
+	pthread_mutex_lock(&ra_mutex);
+	if (ra_cur) {
+		ra_tail++;
+		pthread_cond_broadcast(&ra_cond);
+	}
+	while (ra_head == ra_tail)
+		pthread_cond_wait(&ra_cond, &ra_mutex);
+	pthread_mutex_unlock(&ra_mutex);
+	ra_cur = &ra_ring[ra_tail % RA_RING_BLOCKS];
+#else
+	ra_cur = &ra_ring[0];
+	ra_fill(ra_cur);
+#endif
+
+	if (ra_cur->error) {
+#if WL_GZIP
+		if (ra_cur->error < 0) {
+			int err;
+			const char *msg = gzerror(gz_file, &err);
+
+			fprintf(stderr, "gzread: %s\n",
+			        err == Z_ERRNO ? strerror(errno) : msg);
+			error();
+		}
+#endif
+		errno = ra_cur->error;
+		pexit("read");
+	}
+
+	map_pos = ra_cur->data;
+	map_end = map_pos + ra_cur->len;
+	map_scan_end = map_end - 16;
+
+	if (!ra_cur->len)
+		ra_done = 1;
+	return ra_cur->len != 0;
+}
+
+/* Like mgetl() but for the read-ahead ring. */
+static MAYBE_INLINE char *rgetl(char *res)
+{
+	while (map_pos >= map_end)
+		if (!ra_next_block())
+			return NULL;
+
+	return mgetl(res);
+}
+
+static int64_t ra_tell(void)
+{
+	if (!ra_cur)
+		return ra_out_pos;
+	return ra_cur->start +
+		((map_pos < map_end ? map_pos : map_end) - ra_cur->data);
+}
+
+/* Continue from an uncompressed offset, as saved by fix_state(). */
+static void ra_seek(int64_t pos)
+{
+	ra_stop_thread();
+#if WL_GZIP
+	if (gz_file) {
+		if (gzseek(gz_file, pos, SEEK_SET) < 0) {
+			int err;
+
+			fprintf(stderr, "gzseek: %s\n",
+			        gzerror(gz_file, &err));
+			error();
+		}
+	} else
+#endif
+	if (lseek(ra_fd, pos, SEEK_SET) < 0)
+		pexit("lseek");
+	ra_start(pos);
+}
+
+static void ra_alloc(int64_t file_len)
+{
+	int i;
+
+	ra_file_len = file_len;
+	for (i = 0; i < RA_RING_BLOCKS; i++)
+		ra_ring[i].data = mem_alloc(RA_BLOCK_SIZE + 16);
+	ra_carry = mem_alloc(RA_BLOCK_SIZE);
+	ra_active = 1;
+}
+
+#if WL_READ_THREAD
+static void ra_open(int fd, int64_t file_len)
+{
+	ra_fd = fd;
+	ra_alloc(file_len);
+}
+#endif
+
+static void ra_close(void)
+{
+	int i;
+
+#if WL_READ_THREAD
+	pthread_mutex_lock(&ra_mutex);
+	if (ra_running && !ra_finished && ra_fd == fileno(stdin)) {
+		/*
+		 * The reader may be blocked on a pipe that's still open, so
+		 * just let it go. It frees its buffers when it exits, and
+		 * won't read again once it sees ra_stop.
+		 */
+		ra_stop = 1;
+		ra_detached = 1;
+		pthread_mutex_unlock(&ra_mutex);
+		pthread_detach(ra_thread);
+		ra_running = ra_active = 0;
+		ra_fd = -1;
+		ra_cur = NULL;
+		map_pos = map_end = NULL;
+		return;
+	}
+	pthread_mutex_unlock(&ra_mutex);
+#endif
+	ra_stop_thread();
+#if WL_GZIP
+	if (gz_file)
+		gzclose(gz_file);
+	gz_file = NULL;
+#endif
+	ra_fd = -1;
+	for (i = 0; i < RA_RING_BLOCKS; i++)
+		MEM_FREE(ra_ring[i].data);
+	MEM_FREE(ra_carry);
+	ra_active = 0;
+	ra_cur = NULL;
+	map_pos = map_end = NULL;
+}
+#endif
+
+#if WL_GZIP
+static void gz_open(char *name, int64_t file_len)
+{
+	if (!(gz_file = gzopen(name, "rb")))
+		pexit("gzopen: %s", name);
+	gzbuffer(gz_file, 0x40000);
+	ra_alloc(file_len);
+}
+
+/*
+ * The gzip trailer holds the uncompressed size (of the last member, modulo
+ * 2^32). Good enough for deciding whether to load the list into memory.
+ */
+static int64_t gz_size_hint(FILE *file, int64_t file_len)
+{
+	unsigned char isize[4];
+
+	if (file_len < 18 || jtr_fseek64(file, file_len - 4, SEEK_SET) ||
+	    fread(isize, 1, 4, file) != 4)
+		return file_len;
+	jtr_fseek64(file, 0, SEEK_SET);
+	return isize[0] | isize[1] << 8 | isize[2] << 16 |
+		(int64_t)isize[3] << 24;
+}
+
+/*
+ * Decompress the whole file to memory, starting with the hinted size.  The
+ * hint can be far off (see above), so give up and return NULL if the data
+ * turns out to be bigger than limit (0 for no limit).
+ */
+static char *gz_load(int64_t *len, size_t limit)
+{
+	size_t size = *len > 0 ? *len : 0x10000, used = 0;
+	char *buf;
+	int n, err;
+
+	if (limit && size > limit)
+		size = limit;
+	buf = mem_alloc(size + LINE_BUFFER_SIZE + 1);
+
+	/* Reading one byte past the hint tells us whether it was right */
+	for (;;) {
+		if (used > size) {
+			char *p;
+
+			if (limit && used > limit) {
+				MEM_FREE(buf);
+				return NULL;
+			}
+			size *= 2;
+			if (limit && size > limit)
+				size = limit;
+			p = mem_alloc(size + LINE_BUFFER_SIZE + 1);
+			memcpy(p, buf, used);
+			MEM_FREE(buf);
+			buf = p;
+		}
+		n = gzread(gz_file, buf + used, size + 1 - used > 0x40000000 ?
+		           0x40000000 : size + 1 - used);
+		if (n <= 0)
+			break;
+		used += n;
+	}
+	if (n < 0 || (gzerror(gz_file, &err), err != Z_OK)) {
+		const char *msg = gzerror(gz_file, &err);
+
+		fprintf(stderr, "gzread: %s\n",
+		        err == Z_ERRNO ? strerror(errno) : msg);
+		error();
+	}
+
+	*len = used;
+	return buf;
+}
+#endif
+
+/* Identify a compressed wordlist by its magic bytes. */
+static const char *compression_type(FILE *file)
+{
+	unsigned char magic[6];
+	size_t n = fread(magic, 1, sizeof(magic), file);
+
+	jtr_fseek64(file, 0, SEEK_SET);
+	if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+		return "gzip";
+	if (n >= 6 && !memcmp(magic, "\xfd" "7zXZ\0", 6))
+		return "xz";
+	if (n >= 4 && !memcmp(magic, "\x28\xb5\x2f\xfd", 4))
+		return "zstd";
+	return NULL;
+}
+
+/* Next line from whatever kind of wordlist file we have open. */
+static MAYBE_INLINE char *wl_getl(char *line)
+{
+#if WL_READ_AHEAD
+	if (ra_active)
+		return rgetl(line);
+#endif
+	return mem_map ? mgetl(line) :
+		fgetl(line, LINE_BUFFER_SIZE, word_file);
+}
+
+#if defined(__SSE2__) && !defined(__APPLE__) && !defined(_MSC_VER)
+#define WL_SIMD_SCAN 1
+#ifdef __GNUC__
+#define wl_ctz(v)	__builtin_ctz(v)
+#define wl_popcount(v)	__builtin_popcount(v)
+#else
+#define wl_ctz(v)	(ffs(v) - 1)
+static MAYBE_INLINE unsigned int wl_popcount(unsigned int v)
+{
+	unsigned int n;
+
+	for (n = 0; v; n++)
+		v &= v - 1;
+	return n;
+}
+#endif
+#endif
+
+/*
+ * Count the c characters in a buffer, for sizing the words[] index. This
+ * used to be a memchr() call per line.
+ */
+static int64_t count_lines(const char *p, size_t len, char c)
+{
+	const char *end = p + len;
+	int64_t n = 0;
+
+#if WL_SIMD_SCAN && defined(__AVX2__)
+	__m256i cx32 = _mm256_set1_epi8(c);
+
+	while (p + 32 <= end) {
+		__m256i x = _mm256_loadu_si256((__m256i const *)p);
+
+		n += wl_popcount((unsigned int)
+		                 _mm256_movemask_epi8(_mm256_cmpeq_epi8(cx32, x)));
+		p += 32;
+	}
+#elif WL_SIMD_SCAN
+	__m128i cx16 = _mm_set1_epi8(c);
+
+	while (p + 16 <= end) {
+		__m128i x = _mm_loadu_si128((__m128i const *)p);
+
+		n += wl_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(cx16, x)));
+		p += 16;
+	}
+#endif
+	while (p < end)
+		n += (*p++ == c);
+
+	return n;
+}
+
+/*
+ * Find the end of the line at p: LF, CR or NUL, or end if none. The buffer
+ * must be readable (but need not be initialized) up to end + 31.
+ */
+static MAYBE_INLINE char *find_eol(char *p, char *end)
+{
+#if WL_SIMD_SCAN && defined(__AVX2__)
+	__m256i lf = _mm256_set1_epi8('\n');
+	__m256i cr = _mm256_set1_epi8('\r');
+	__m256i nul = _mm256_setzero_si256();
+
+	while (p < end) {
+		__m256i x = _mm256_loadu_si256((__m256i const *)p);
+		unsigned int v = _mm256_movemask_epi8(
+			_mm256_or_si256(_mm256_or_si256(
+				_mm256_cmpeq_epi8(x, lf),
+				_mm256_cmpeq_epi8(x, cr)),
+				_mm256_cmpeq_epi8(x, nul)));
+
+		if (v) {
+			p += wl_ctz(v);
+			return p < end ? p : end;
+		}
+		p += 32;
+	}
+	return end;
+#elif WL_SIMD_SCAN
+	__m128i lf = _mm_set1_epi8('\n');
+	__m128i cr = _mm_set1_epi8('\r');
+	__m128i nul = _mm_setzero_si128();
+
+	while (p < end) {
+		__m128i x = _mm_loadu_si128((__m128i const *)p);
+		unsigned int v = _mm_movemask_epi8(
+			_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, lf),
+			                          _mm_cmpeq_epi8(x, cr)),
+			             _mm_cmpeq_epi8(x, nul)));
+
+		if (v) {
+			p += wl_ctz(v);
+			return p < end ? p : end;
+		}
+		p += 16;
+	}
+	return end;
+#else
+	while (p < end && *p && *p != '\n' && *p != '\r')
+		p++;
+	return p;
+#endif
+}
+
+/*
+ * Like mgetl() but just skips the line, splitting overlong ones the same
+ * way so that line numbers (and thus --node shares) stay the same.
+ */
+static MAYBE_INLINE int mskipl(void)
+{
+	char *lim = map_pos + LINE_BUFFER_SIZE;
+
+	if (map_pos >= map_end)
+		return 0;
+	if (lim > map_end)
+		lim = map_end;
+
+#if WL_SIMD_SCAN
+	{
+		__m128i cx16 = _mm_set1_epi8('\n');
+
+		while (map_pos + 16 <= lim) {
+			__m128i x = _mm_loadu_si128((__m128i const *)map_pos);
+			unsigned int v =
+				_mm_movemask_epi8(_mm_cmpeq_epi8(cx16, x));
+
+			if (v) {
+				map_pos += wl_ctz(v) + 1;
+				return 1;
+			}
+			map_pos += 16;
+		}
+	}
+#endif
+	while (map_pos < lim)
+		if (*map_pos++ == '\n')
+			return 1;
+
+	return 1;
+}
+
+/* Back to the start of the wordlist file. */
+static void wl_rewind(void)
+{
+#if WL_READ_AHEAD
+	if (ra_active)
+		ra_seek(0);
+	else
+#endif
+	if (mem_map)
+		map_pos = mem_map;
+	else
+	if (jtr_fseek64(word_file, 0, SEEK_SET))
+		pexit(STR_MACRO(jtr_fseek64));
+}
+
 static MAYBE_INLINE int skip_lines(unsigned long n, char *line)
 {
 	if (n) {
@@ -249,8 +852,7 @@ static MAYBE_INLINE int skip_lines(unsigned long n, char *line)
 
 		if (!nWordFileLines)
 		do {
-			if (mem_map ? !mgetl(line) :
-			    !fgetl(line, LINE_BUFFER_SIZE, word_file))
+			if (mem_map ? !mskipl() : !wl_getl(line))
 				return 1;
 		} while (--n);
 	}
@@ -292,10 +894,29 @@ static int restore_state(FILE *file)
 	if (word_file == stdin) {
 		restore_line_number();
 	} else
-	if (!nWordFileLines) {
+	if (nWordFileLines) {
+		/* words[] is indexed by line, so just continue from there */
+		if (rec_line > nWordFileLines)
+			return 1;
+		line_number = rec_line;
+	} else {
+#if WL_READ_AHEAD
+		if (ra_active)
+			ra_seek(rec_pos);
+		else
+#endif
 		if (mem_map) {
-			char line[LINE_BUFFER_SIZE];
-			skip_lines(rec_line, line);
+			/*
+			 * Older sessions only have a line number for a mapped
+			 * file. If we have a sane offset, jump straight there.
+			 */
+			if (rec_pos > 0 && rec_pos <= map_end - mem_map &&
+			    mem_map[rec_pos - 1] == '\n')
+				map_pos = mem_map + rec_pos;
+			else {
+				char line[LINE_BUFFER_SIZE];
+				skip_lines(rec_line, line);
+			}
 		} else
 		if (jtr_fseek64(word_file, rec_pos, SEEK_SET))
 			pexit(STR_MACRO(jtr_fseek64));
@@ -319,6 +940,14 @@ static void fix_state(void)
 	if (word_file == stdin)
 		rec_pos = line_number;
 	else
+#if WL_READ_AHEAD
+	if (ra_active)
+		rec_pos = ra_tell();
+	else
+#endif
+	if (mem_map)
+		rec_pos = (map_pos < map_end ? map_pos : map_end) - mem_map;
+	else
 	if ((rec_pos = jtr_ftell64(word_file)) < 0) {
 #ifdef __DJGPP__
 		if (rec_pos != -1)
@@ -345,6 +974,12 @@ static double get_progress(void)
 	if (nWordFileLines) {
 		pos = line_number;
 		size = nWordFileLines;
+#if WL_READ_AHEAD
+	} else if (ra_active) {
+		/* Uncompressed size may be unknown, so go by what we've read */
+		pos = ra_cur ? ra_cur->in_pos : 0;
+		size = ra_file_len;
+#endif
 	} else if (mem_map) {
 		pos = map_pos - mem_map;
 		size = map_end - mem_map;
@@ -495,6 +1130,187 @@ static MAYBE_INLINE int wbuf_unique(char *line)
 	return 1;
 }
 
+/*
+ * --dupe-suppression for a list we don't load into memory. One pass over
+ * the file, with a table of 64-bit fingerprints bounded by the configured
+ * memory, marks every repeated line in a bitmap. Later passes (rules,
+ * restored sessions, nodes) just consult the bitmap by line number. If the
+ * table fills up, we keep checking against what's in it but stop adding,
+ * so that some repeats of later words will get through.
+ */
+static unsigned char *dupe_map;
+static int64_t dupe_map_lines;
+
+static MAYBE_INLINE uint64_t line_fingerprint(const char *line)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (*line) {
+		hash ^= (unsigned char)*line++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash ? hash : 1;
+}
+
+static MAYBE_INLINE int dupe_map_check(int64_t line)
+{
+	return line < dupe_map_lines && (dupe_map[line >> 3] >> (line & 7) & 1);
+}
+
+/*
+ * Optional filter for candidates the rules have already produced. It's a
+ * table of 64-bit fingerprints in buckets of two, where a new candidate
+ * pushes out the older entry of its bucket, so it remembers roughly the
+ * most recent candidates that fit. A repeat that has been pushed out just
+ * gets tried again.
+ */
+static uint64_t *rule_dupe_table;
+static size_t rule_dupe_mask;
+static uint64_t rule_dupe_checked, rule_dupe_hits;
+
+static MAYBE_INLINE int rule_dupe(const char *word)
+{
+	uint64_t fp = line_fingerprint(word);
+	uint64_t *bucket = &rule_dupe_table[(fp & rule_dupe_mask) << 1];
+
+	rule_dupe_checked++;
+	if (bucket[0] == fp || bucket[1] == fp) {
+		rule_dupe_hits++;
+		return 1;
+	}
+	bucket[1] = bucket[0];
+	bucket[0] = fp;
+
+	return 0;
+}
+
+static void rule_dupe_init(void)
+{
+	int size;
+	size_t buckets = 1;
+
+	if ((size = cfg_get_int(SECTION_OPTIONS, NULL,
+	                        "RulesDupeFilterSize")) < 0)
+		size = RULES_DUPE_FILTER_SIZE;
+	if (!size)
+		return;
+
+	while (buckets * 2 * 2 * sizeof(uint64_t) <= (size_t)size << 20)
+		buckets <<= 1;
+	rule_dupe_table = mem_calloc(buckets * 2 * sizeof(uint64_t));
+	rule_dupe_mask = buckets - 1;
+	rule_dupe_checked = rule_dupe_hits = 0;
+
+	log_event("- Rule dupe filter: %d MB, "Zu" candidates", size,
+	          buckets * 2);
+}
+
+static void rule_dupe_done(void)
+{
+	if (!rule_dupe_table)
+		return;
+
+	log_event("- Rule dupe filter suppressed "LLu" of "LLu" candidates"
+	          " (%.1f%%)", (unsigned long long)rule_dupe_hits,
+	          (unsigned long long)rule_dupe_checked,
+	          rule_dupe_checked ?
+	          100.0 * rule_dupe_hits / rule_dupe_checked : 0.0);
+	MEM_FREE(rule_dupe_table);
+}
+
+static void dupe_map_build(int rules, int length, int minlength,
+                           int maxlength, size_t max_memory)
+{
+	char line[LINE_BUFFER_SIZE];
+	uint64_t *table;
+	size_t size = 0x10000, count = 0, max_size = 0x10000, map_size = 0x10000;
+	int64_t dupes = 0;
+	int full = 0;
+
+	while (max_size < max_memory / sizeof(uint64_t) / 2)
+		max_size <<= 1;
+	table = mem_calloc(size * sizeof(uint64_t));
+	dupe_map = mem_calloc(map_size);
+	dupe_map_lines = 0;
+
+	while (wl_getl(line)) {
+		if ((dupe_map_lines >> 3) >= map_size) {
+			unsigned char *new_map = mem_calloc(2 * map_size);
+
+			memcpy(new_map, dupe_map, map_size);
+			MEM_FREE(dupe_map);
+			dupe_map = new_map;
+			map_size *= 2;
+		}
+
+		if (strncmp(line, "#!comment", 9)) {
+			char *key = convert(line);
+			uint64_t fp;
+			size_t index;
+
+			if (!rules) {
+				/* Lines the crack loop skips can't be dupes */
+				if (minlength || maxlength) {
+					int len = strlen(key);
+
+					if ((minlength && len < minlength) ||
+					    (maxlength && len > maxlength))
+						goto next_line;
+				}
+				key[length] = 0;
+			}
+			fp = line_fingerprint(key);
+			index = fp & (size - 1);
+			while (table[index] && table[index] != fp)
+				index = (index + 1) & (size - 1);
+
+			if (table[index]) {
+				dupe_map[dupe_map_lines >> 3] |=
+					1 << (dupe_map_lines & 7);
+				dupes++;
+			} else if (!full) {
+				table[index] = fp;
+				if (++count > size / 4 * 3) {
+					if (size < max_size) {
+						uint64_t *old = table;
+						size_t i;
+
+						table = mem_calloc(2 * size *
+						                   sizeof(uint64_t));
+						for (i = 0; i < size; i++) {
+							if (!old[i])
+								continue;
+							index = old[i] &
+								(2 * size - 1);
+							while (table[index])
+								index = (index + 1) &
+									(2 * size - 1);
+							table[index] = old[i];
+						}
+						MEM_FREE(old);
+						size *= 2;
+					} else {
+						full = 1;
+						log_event("- dupe suppression table"
+						          " full after "Zu" unique"
+						          " words, not adding more",
+						          count);
+					}
+				}
+			}
+		}
+next_line:
+		dupe_map_lines++;
+	}
+
+	MEM_FREE(table);
+	wl_rewind();
+
+	log_event("- dupe suppression: "LLd" of "LLd" lines are duplicates",
+	          (long long)dupes, (long long)dupe_map_lines);
+}
+
 void do_wordlist_crack(struct db_main *db, char *name, int rules)
 {
 	union {
@@ -516,6 +1332,7 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 #endif
 	char msg_buf[128];
 	int forceLoad = 0;
+	int dupe_memory;
 	int dupeCheck = (options.flags & FLG_DUPESUPP) ? 1 : 0;
 	int loopBack = (options.flags & FLG_LOOPBACK_CHK) ? 1 : 0;
 	int do_lmloop = loopBack && db->plaintexts->head;
@@ -554,10 +1371,13 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 			name = options.wordlist = pers_opts.activepot;
 	}
 
-	if (!mem_saving_level &&
-	    (dupeCheck || !options.max_wordfile_memory))
+	if (!mem_saving_level && !options.max_wordfile_memory)
 		forceLoad = 1;
 
+	if ((dupe_memory = cfg_get_int(SECTION_OPTIONS, NULL,
+	                               "WordlistDupeMemory")) < 0)
+		dupe_memory = WORDLIST_DUPE_MEMORY;
+
 	/* If we did not give a name for wordlist mode,
 	   we use the "batch mode" one from john.conf */
 	if (!name && !(options.flags & (FLG_STDIN_CHK | FLG_PIPE_CHK)))
@@ -568,6 +1388,7 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 	if (name) {
 		char *cp, csearch;
 		int64_t ourshare = 0;
+		const char *compressed;
 
 		if (!(word_file = jtr_fopen(path_expand(name), "rb")))
 			pexit(STR_MACRO(jtr_fopen)": %s", path_expand(name));
@@ -586,32 +1407,64 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 			error();
 		}
 
+		if ((compressed = compression_type(word_file))) {
+#if WL_GZIP
+			if (!strcmp(compressed, "gzip")) {
+				log_event("- decompressing gzip wordlist on "
+				          "the fly");
+				gz_open(path_expand(name), file_len);
+				/* From here on, sizes are uncompressed */
+				file_len = gz_size_hint(word_file, file_len);
+			} else
+#endif
+			{
+				if (john_main_process)
+					fprintf(stderr, "Error, %s compressed "
+					        "wordlists are not supported by "
+					        "this build\n", compressed);
+				error();
+			}
+		}
+
 #ifdef HAVE_MMAP
-		log_event("- memory mapping wordlist ("LLd" bytes)",
-		          (long long)file_len);
+		if (!compressed) {
+			log_event("- memory mapping wordlist ("LLd" bytes)",
+			          (long long)file_len);
 #if (SIZEOF_SIZE_T < 8)
-		/* Now even though we are 64 bit file size, we must still
-		 * deal with some 32 bit functions ;) */
-		mem_map = MAP_FAILED;
-		if (file_len < ((1LL)<<32))
-#endif
-		mem_map = mmap(NULL, file_len,
-		               PROT_READ, MAP_SHARED,
-		               fileno(word_file), 0);
-		if (mem_map == MAP_FAILED) {
-			mem_map = NULL;
+			/* Now even though we are 64 bit file size, we must
+			 * still deal with some 32 bit functions ;) */
+			mem_map = MAP_FAILED;
+			if (file_len < ((1LL)<<32))
+#endif
+			mem_map = mmap(NULL, file_len,
+			               PROT_READ, MAP_SHARED,
+			               fileno(word_file), 0);
+			if (mem_map == MAP_FAILED) {
+				mem_map = NULL;
 #ifdef DEBUG
-			fprintf(stderr, "wordlist: memory mapping failed (%s) (non-fatal)\n",
-			        strerror(errno));
+				fprintf(stderr, "wordlist: memory mapping "
+				        "failed (%s) (non-fatal)\n",
+				        strerror(errno));
 #endif
-			log_event("- memory mapping failed (%s) - but we'll do "
-			          "fine without it.", strerror(errno));
-		} else {
-			map_pos = mem_map;
-			map_end = mem_map + file_len;
-			map_scan_end = map_end - 16;
+				log_event("- memory mapping failed (%s) - but "
+				          "we'll do fine without it.",
+				          strerror(errno));
+			} else {
+				map_pos = mem_map;
+				map_end = mem_map + file_len;
+				map_scan_end = map_end - 16;
+			}
 		}
 #endif
+#if WL_READ_THREAD
+		if (!compressed && !mem_map)
+			ra_open(fileno(word_file), file_len);
+#endif
+
+		/* Bigger lists are dupe suppressed while streaming instead */
+		if (dupeCheck && !mem_saving_level &&
+		    file_len <= (int64_t)dupe_memory << 20)
+			forceLoad = 1;
 
 		ourshare = options.node_count ?
 			(file_len / options.node_count) *
@@ -643,6 +1496,11 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 						for_node < options.node_min ||
 						for_node > options.node_max;
 
+					if (skip) {
+						if (!mskipl())
+							break;
+						continue;
+					}
 					if (!mgetl(line))
 						break;
 					if (!strncmp(line, "#!comment", 9))
@@ -650,8 +1508,7 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 					lp = convert(line);
 					if (!rules)
 						lp[length] = 0;
-					if (!skip)
-						my_size += strlen(lp) + 1;
+					my_size += strlen(lp) + 1;
 				}
 				map_pos = mem_map;
 
@@ -669,6 +1526,11 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 						for_node < options.node_min ||
 						for_node > options.node_max;
 
+					if (skip) {
+						if (!mskipl())
+							break;
+						continue;
+					}
 					if (!mgetl(line))
 						break;
 					if (!strncmp(line, "#!comment", 9))
@@ -676,11 +1538,9 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 					lp = convert(line);
 					if (!rules)
 						lp[length] = 0;
-					if (!skip) {
-						strcpy(&word_file_str[i], lp);
-						i += strlen(lp);
-						word_file_str[i++] = '\n';
-					}
+					strcpy(&word_file_str[i], lp);
+					i += strlen(lp);
+					word_file_str[i++] = '\n';
 					if (i > my_size) {
 						fprintf(stderr,
 						        "Error: wordlist grew "
@@ -716,17 +1576,37 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 				if (options.node_count > 1 && john_main_process)
 				fprintf(stderr,"Each node loaded the whole "
 				        "wordfile to memory\n");
-				word_file_str =
-					mem_alloc_tiny((size_t)file_len +
-					               LINE_BUFFER_SIZE + 1,
-					               MEM_ALIGN_NONE);
-				if (fread(word_file_str, 1, (size_t)file_len,
-				          word_file) != file_len) {
-					if (ferror(word_file))
-						pexit("fread");
-					fprintf(stderr,
-					        "fread: Unexpected EOF\n");
-					error();
+#if WL_GZIP
+				if (gz_file) {
+					size_t limit = options.max_wordfile_memory;
+
+					if (limit && dupeCheck &&
+					    ((size_t)dupe_memory << 20) > limit)
+						limit = (size_t)dupe_memory << 20;
+					if (!(word_file_str = gz_load(&file_len,
+					                              limit))) {
+						log_event("- gzip wordlist is over "
+						          Zu" bytes uncompressed, "
+						          "streaming it instead",
+						          limit);
+						goto gz_stream;
+					}
+				} else
+#endif
+				{
+					word_file_str = mem_alloc_tiny(
+						(size_t)file_len +
+						LINE_BUFFER_SIZE + 1,
+						MEM_ALIGN_NONE);
+					if (fread(word_file_str, 1,
+					          (size_t)file_len, word_file)
+					    != file_len) {
+						if (ferror(word_file))
+							pexit("fread");
+						fprintf(stderr,
+						        "fread: Unexpected EOF\n");
+						error();
+					}
 				}
 				if (memchr(word_file_str, 0, (size_t)file_len)) {
 					fprintf(stderr,
@@ -738,15 +1618,14 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 			aep = word_file_str + file_len;
 			*aep = 0;
 			csearch = '\n';
-			cp = memchr(word_file_str, csearch, (size_t)file_len);
-			if (!cp)
-			{
+			nWordFileLines = count_lines(word_file_str,
+			                             (size_t)file_len, csearch);
+			if (!nWordFileLines) {
 				csearch = '\r';
-				cp = memchr(word_file_str, csearch, (size_t)file_len);
+				nWordFileLines = count_lines(word_file_str,
+				                             (size_t)file_len,
+				                             csearch);
 			}
-			for (nWordFileLines = 0; cp; ++nWordFileLines)
-				cp = memchr(&cp[1], csearch, (size_t)(file_len -
-				            (cp - word_file_str) - 1));
 			if (aep[-1] != csearch)
 				++nWordFileLines;
 			words = mem_alloc((nWordFileLines + 1) * sizeof(char*));
@@ -798,9 +1677,7 @@ void do_wordlist_crack(struct db_main *db, char *name, int rules)
 				}
 				if (!myWordFileLines)
 					cp = convert(cp);
-				ep = cp;
-				while ((ep < aep) && *ep && *ep != '\n' && *ep != '\r')
-					ep++;
+				ep = find_eol(cp, aep);
 				ec = *ep;
 				*ep = 0;
 				if (strncmp(cp, "#!comment", 9)) {
@@ -841,6 +1718,16 @@ skip:
 			MEM_FREE(buffer.data);
 			nWordFileLines = i;
 		}
+#if WL_GZIP
+gz_stream:
+#endif
+#if WL_READ_AHEAD
+		if (ra_active && !nWordFileLines)
+			ra_seek(0);
+#endif
+		if (dupeCheck && !nWordFileLines)
+			dupe_map_build(rules, length, minlength, maxlength,
+			               (size_t)dupe_memory << 20);
 	} else {
 /*
  * Ok, we can be in --stdin or --pipe mode.  In --stdin, we simply copy over
@@ -854,6 +1741,10 @@ skip:
 		word_file = stdin;
 		if (options.flags & FLG_STDIN_CHK) {
 			log_event("- Reading candidate passwords from stdin");
+#if WL_READ_THREAD
+			ra_open(fileno(stdin), 0);
+			ra_start(0);
+#endif
 		} else {
 			pipe_input = 1;
 #if HAVE_WINDOWS_H
@@ -864,6 +1755,11 @@ skip:
 				words = mem_alloc(max_pipe_words*sizeof(char*));
 				goto MEM_MAP_LOAD;
 			}
+#endif
+#if WL_READ_THREAD
+			/* Next block is read while we crack this one */
+			ra_open(fileno(stdin), 0);
+			ra_start(0);
 #endif
 			if (options.max_wordfile_memory < 0x20000)
 				options.max_wordfile_memory = 0x20000;
@@ -891,7 +1787,7 @@ GRAB_NEXT_PIPE_LOAD:;
 				cpi = word_file_str;
 				cpe = (cpi + options.max_wordfile_memory) - (LINE_BUFFER_SIZE + 1);
 				while (nWordFileLines < max_pipe_words) {
-					if (!fgetl(cpi, LINE_BUFFER_SIZE, word_file)) {
+					if (!wl_getl(cpi)) {
 						pipe_input = 0;
 						break;
 					}
@@ -1006,6 +1902,9 @@ REDO_AFTER_LMLOOP:
 		rec_init(db, save_state);
 
 		crk_init(db, fix_state, NULL);
+
+		if (rules)
+			rule_dupe_init();
 	}
 
 	prerule = rule = "";
@@ -1114,6 +2013,9 @@ REDO_AFTER_LMLOOP:
 			if ((word = apply(joined->data, rule, -1, last))) {
 				last = word;
 
+				if (rule_dupe_table && rule_dupe(word))
+					continue;
+
 				if (options.mask) {
 					if (do_mask_crack(word)) {
 						rule = NULL;
@@ -1160,6 +2062,9 @@ REDO_AFTER_LMLOOP:
 			if ((word = apply(line, rule, -1, last))) {
 				last = word;
 
+				if (rule_dupe_table && rule_dupe(word))
+					continue;
+
 				if (options.mask) {
 					if (do_mask_crack(word)) {
 						rule = NULL;
@@ -1183,10 +2088,12 @@ REDO_AFTER_LMLOOP:
 		}
 
 		else if (rule)
-		while (mem_map ? mgetl(line) :
-		       fgetl(line, LINE_BUFFER_SIZE, word_file)) {
+		while (wl_getl(line)) {
 			line_number++;
 
+			if (dupe_map && dupe_map_check(line_number - 1))
+				goto next_word;
+
 			if (line[0] != '#') {
 process_word:
 				if (pers_opts.input_enc != pers_opts.target_enc
@@ -1216,6 +2123,9 @@ process_word:
 					else
 						strcpy(last, word);
 
+					if (rule_dupe_table && rule_dupe(word))
+						goto next_word;
+
 					if (options.mask) {
 						if (do_mask_crack(word)) {
 							rule = NULL;
@@ -1271,13 +2181,8 @@ next_rule:
 			}
 
 			line_number = 0;
-			if (!nWordFileLines && word_file != stdin) {
-				if (mem_map)
-					map_pos = mem_map;
-				else
-				if (jtr_fseek64(word_file, 0, SEEK_SET))
-					pexit(STR_MACRO(jtr_fseek64));
-			}
+			if (!nWordFileLines && word_file != stdin)
+				wl_rewind();
 			if (their_words &&
 			    skip_lines(options.node_min - 1, line))
 				break;
@@ -1300,6 +2205,20 @@ next_rule:
 
 	if (ferror(word_file)) pexit("fgets");
 
+#if WL_READ_AHEAD
+	if (ra_active) {
+#if WL_GZIP
+		if (gz_file)
+			MEM_FREE(word_file_str);
+#endif
+		ra_close();
+	}
+#endif
+
+	MEM_FREE(dupe_map);
+	dupe_map_lines = 0;
+	rule_dupe_done();
+
 	if (max_pipe_words)  // pipe_input was already cleared.
 		MEM_FREE(words);
 
@@ -88,7 +88,17 @@
 #define CPU_FALLBACK_BINARY_DEFAULT
 #endif
 #define DES_BS_ASM			0
-#if 0
+#if defined(__AVX512F__)
+/* 512-bit, bitselect is one vpternlogq */
+#undef DES_BS
+#define DES_BS				3
+#define DES_BS_VECTOR			8
+#define DES_BS_ALGORITHM_NAME		"DES 512/512 AVX512F-16"
+#elif defined(__AVX2__)
+/* 256-bit, with integer bitwise ops and shifts */
+#define DES_BS_VECTOR			4
+#define DES_BS_ALGORITHM_NAME		"DES 256/256 AVX2-16"
+#elif 0
 /* 512-bit as 2x256 */
 #define DES_BS_VECTOR			8
 #if defined(JOHN_XOP) && defined(__GNUC__)
@@ -190,7 +200,24 @@
 #endif
 #define DES_BS_EXPAND			1
 
-#if CPU_DETECT && DES_BS == 3
+#if CPU_DETECT && defined(__AVX512F__)
+#define CPU_REQ_AVX2
+#define CPU_REQ_AVX512F
+#undef CPU_NAME
+#define CPU_NAME			"AVX512F"
+#ifdef CPU_FALLBACK_BINARY_DEFAULT
+#undef CPU_FALLBACK_BINARY
+#define CPU_FALLBACK_BINARY		"john-non-avx512"
+#endif
+#elif CPU_DETECT && defined(__AVX2__)
+#define CPU_REQ_AVX2
+#undef CPU_NAME
+#define CPU_NAME			"AVX2"
+#ifdef CPU_FALLBACK_BINARY_DEFAULT
+#undef CPU_FALLBACK_BINARY
+#define CPU_FALLBACK_BINARY		"john-non-avx2"
+#endif
+#elif CPU_DETECT && DES_BS == 3
 #define CPU_REQ_XOP
 #undef CPU_NAME
 #define CPU_NAME			"XOP"
@@ -318,6 +345,10 @@
 
 #define MMX_COEF_SHA256 4
 #define MMX_COEF_SHA512 2
+/* The prebuilt icc sse-intrinsics-*.S files predate RIPEMD-160 */
+#ifndef USING_ICC_S_FILE
+#define MMX_COEF_RIPEMD160 4
+#endif
 
 #endif /* __SSE2__ */
 
@@ -274,5 +274,9 @@
 
 #define MMX_COEF_SHA256 4
 #define MMX_COEF_SHA512 2
+/* The prebuilt icc sse-intrinsics-*.S files predate RIPEMD-160 */
+#ifndef USING_ICC_S_FILE
+#define MMX_COEF_RIPEMD160 4
+#endif
 
 #endif
@@ -116,6 +116,16 @@ static unsigned char (*crypt_key)[((BINARY_SIZE+3)/4)*4];
 
 static my_salt *saved_salt;
 
+/*
+ * The PBKDF2 output only depends on the key, the mode and the salt bytes.
+ * Files which share those (e.g. the same archive listed more than once)
+ * reuse the derived keys; salt_compare() sorts them next to each other.
+ */
+static unsigned char (*derived)[4+64];
+static unsigned char last_salt[SALT_LENGTH(3)];
+static int last_mode = -1;
+static int new_keys;
+
 
 //    filename:$zip2$*Ty*Mo*Ma*Sa*Va*Le*DF*Au*$/zip2$
 //    Ty = type (0) and ignored.
@@ -165,6 +175,7 @@ static void init(struct fmt_main *self)
 	saved_key = mem_calloc_tiny(sizeof(*saved_key) *
 			self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 	crypt_key = mem_calloc_tiny(sizeof(*crypt_key) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
+	derived = mem_calloc_tiny(sizeof(*derived) * self->params.max_keys_per_crypt, MEM_ALIGN_WORD);
 }
 
 static const char *ValidateZipFileData(u8 *Fn, u8 *Oh, u8 *Ob, unsigned len, u8 *Auth) {
@@ -424,6 +435,15 @@ static void set_salt(void *salt)
 	saved_salt = *((my_salt**)salt);
 }
 
+static int salt_compare(const void *x, const void *y)
+{
+	const my_salt *a = *((my_salt**)x), *b = *((my_salt**)y);
+
+	if (a->v.mode != b->v.mode)
+		return a->v.mode < b->v.mode ? -1 : 1;
+	return memcmp(a->salt, b->salt, SALT_LENGTH(a->v.mode));
+}
+
 static void set_key(char *key, int index)
 {
 	int saved_key_length = strlen(key);
@@ -431,6 +451,7 @@ static void set_key(char *key, int index)
 		saved_key_length = PLAINTEXT_LENGTH;
 	memcpy(saved_key[index], key, saved_key_length);
 	saved_key[index][saved_key_length] = 0;
+	new_keys = 1;
 }
 
 static char *get_key(int index)
@@ -458,59 +479,55 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 		return count;
 	}
 
+	if (new_keys || last_mode != saved_salt->v.mode ||
+	    memcmp(last_salt, saved_salt->salt, SALT_LENGTH(saved_salt->v.mode))) {
 #ifdef _OPENMP
-#pragma omp parallel for default(none) private(index) shared(count, saved_key, saved_salt, crypt_key)
+#pragma omp parallel for default(none) private(index) shared(count, saved_key, saved_salt, derived)
 #endif
-	for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT) {
+		for (index = 0; index < count; index += MAX_KEYS_PER_CRYPT) {
 #ifdef MMX_COEF
-		unsigned char pwd_ver[(2+64)*MAX_KEYS_PER_CRYPT];
-		int lens[MAX_KEYS_PER_CRYPT], i;
-		unsigned char *pin[MAX_KEYS_PER_CRYPT], *pout[MAX_KEYS_PER_CRYPT];
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
-			lens[i] = strlen(saved_key[i+index]);
-			pin[i] = (unsigned char*)saved_key[i+index];
-			pout[i] = &pwd_ver[i*(2+2*KEY_LENGTH(saved_salt->v.mode))];
-		}
-		pbkdf2_sha1_sse((const unsigned char **)pin, lens, saved_salt->salt, SALT_LENGTH(saved_salt->v.mode), KEYING_ITERATIONS, pout, 2+2*KEY_LENGTH(saved_salt->v.mode), 0);
-		for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
-			if (!memcmp(&(pout[i][KEY_LENGTH(saved_salt->v.mode)<<1]), saved_salt->passverify, 2))
-			{
-				// yes, I know gladman's code but for now that is what I am using.  Later we will improve.
-				hmac_sha1(&(pout[i][KEY_LENGTH(saved_salt->v.mode)]), KEY_LENGTH(saved_salt->v.mode),
-						   (const unsigned char*)saved_salt->datablob, saved_salt->comp_len,
-						   crypt_key[index+i], BINARY_SIZE);
+			int lens[MAX_KEYS_PER_CRYPT], i;
+			unsigned char *pin[MAX_KEYS_PER_CRYPT], *pout[MAX_KEYS_PER_CRYPT];
+			for (i = 0; i < MAX_KEYS_PER_CRYPT; ++i) {
+				lens[i] = strlen(saved_key[i+index]);
+				pin[i] = (unsigned char*)saved_key[i+index];
+				pout[i] = derived[i+index];
 			}
-			else
-				memset(crypt_key[index+i], 0, BINARY_SIZE);
-		}
+			pbkdf2_sha1_sse((const unsigned char **)pin, lens, saved_salt->salt, SALT_LENGTH(saved_salt->v.mode), KEYING_ITERATIONS, pout, 2+2*KEY_LENGTH(saved_salt->v.mode), 0);
 #else
-		int LEN = 2+2*KEY_LENGTH(saved_salt->v.mode);
-		union {
-			// MUST be aligned on 4 byte boundary for alter endianity on BE
-			// we also need 2 extra bytes for endianity flipping.
-			unsigned char pwd_ver[4+64];
-			ARCH_WORD_32 w;
-		} x;
-		unsigned char *pwd_ver = x.pwd_ver;
+			// derived[] rows are 4 byte aligned, with 2 extra bytes for endianity flipping on BE.
+			int LEN = 2+2*KEY_LENGTH(saved_salt->v.mode);
 #if !ARCH_LITTLE_ENDIAN
-		LEN += 2;
+			LEN += 2;
 #endif
-		pbkdf2_sha1((unsigned char *)saved_key[index],
-		       strlen(saved_key[index]), saved_salt->salt, SALT_LENGTH(saved_salt->v.mode),
-		       KEYING_ITERATIONS, pwd_ver, LEN, 0);
+			pbkdf2_sha1((unsigned char *)saved_key[index],
+			       strlen(saved_key[index]), saved_salt->salt, SALT_LENGTH(saved_salt->v.mode),
+			       KEYING_ITERATIONS, derived[index], LEN, 0);
 #if !ARCH_LITTLE_ENDIAN
-		alter_endianity(pwd_ver, LEN);
+			alter_endianity(derived[index], LEN);
 #endif
+#endif
+		}
+		last_mode = saved_salt->v.mode;
+		memcpy(last_salt, saved_salt->salt, SALT_LENGTH(saved_salt->v.mode));
+		new_keys = 0;
+	}
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) private(index) shared(count, saved_salt, crypt_key, derived)
+#endif
+	for (index = 0; index < count; index++) {
+		unsigned char *pwd_ver = derived[index];
+
 		if (!memcmp(&(pwd_ver[KEY_LENGTH(saved_salt->v.mode)<<1]), saved_salt->passverify, 2))
 		{
 			// yes, I know gladman's code but for now that is what I am using.  Later we will improve.
 			hmac_sha1(&(pwd_ver[KEY_LENGTH(saved_salt->v.mode)]), KEY_LENGTH(saved_salt->v.mode),
-                       (const unsigned char*)saved_salt->datablob, saved_salt->comp_len,
-                       crypt_key[index], BINARY_SIZE);
+			          (const unsigned char*)saved_salt->datablob, saved_salt->comp_len,
+			          crypt_key[index], BINARY_SIZE);
 		}
 		else
 			memset(crypt_key[index], 0, BINARY_SIZE);
-#endif
 	}
 	return count;
 }
@@ -579,7 +596,7 @@ struct fmt_main fmt_zip = {
 			fmt_default_binary_hash_6
 		},
 		fmt_default_dyna_salt_hash,
-		NULL,
+		salt_compare,
 		set_salt,
 		set_key,
 		get_key,